@@ -6,3 +6,14 @@ CXX = g++
 INSTALL_DIR = ~/.local/bin
 
 BINNAME = pomocom
+
+# How the optional interfaces are built:
+# module: built as pomocom-(interface).so, which is only loaded when the interface setting selects it
+# static: linked into pomocom, which then always loads the interface's libraries on startup
+# no: left out, so its libraries aren't needed to build pomocom
+NCURSES = module
+WX = module
+
+# Directory that interface modules are installed to and loaded from
+# Modules next to the pomocom binary are loaded first, so pomocom can be run from the project directory
+MODULE_DIR = $(HOME)/.local/lib/pomocom
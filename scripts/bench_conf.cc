@@ -0,0 +1,105 @@
+/*
+ * bench_conf.cc measures how fast pomocom.conf is read and parsed.
+ *
+ * usage: build/linux/scripts/bench_conf [lines in millions]
+ *
+ * A config with 1M lines (by default) is generated from settings_map, mixing "name value" and "name = value" lines, quoted string values with escapes, comments, and blank lines. It is written to a temporary file, and the best of 5 runs of file_read_all() and settings_parse() is printed. Every line must parse without errors.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>	// For std::atof() and mkstemp()
+#include <string>
+
+#include <unistd.h>
+
+#include "fileio.hh"
+#include "settings.hh"
+
+using namespace pomocom;
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start);
+
+// Appends a line setting entry to a valid value to *text, in a style picked by line
+static void append_line(std::string &text, const SettingEntry &entry, long line);
+
+int main(int argc, char **argv)
+{
+	long lines = (argc > 1 ? std::atof(argv[1]) : 1) * 1e6;
+
+	std::string text;
+	for (long line = 0; line < lines; ++line)
+		append_line(text, settings_map[line % settings_map.size()], line);
+
+	char path[] = "/tmp/pomocom-bench-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd == -1 || write(fd, text.data(), text.size()) != (ssize_t) text.size())
+	{
+		std::perror("bench_conf: failed to write the config");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	double read = 1e9, parse = 1e9;
+	bool ok = true;
+	std::string buf;
+	for (int run = 0; run < 5 && ok; ++run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		file_read_all(path, buf);
+		double t = secs_since(start);
+		read = t < read ? t : read;
+
+		ProgramSettings s;
+		start = std::chrono::steady_clock::now();
+		ok = settings_parse(s, buf, path);
+		t = secs_since(start);
+		parse = t < parse ? t : parse;
+	}
+	unlink(path);
+
+	if (!ok)
+	{
+		std::fprintf(stderr, "bench_conf: the generated config had errors\n");
+		return EXIT_FAILURE;
+	}
+	double mb = text.size() / 1e6;
+	std::printf("%ld lines, %.1f MB\n", lines, mb);
+	std::printf("file_read_all(): %.1f ms\n", read * 1e3);
+	std::printf("settings_parse(): %.1f ms, %.0f MB/s\n", parse * 1e3, mb / parse);
+	return EXIT_SUCCESS;
+}
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Appends a line setting entry to a valid value to *text, in a style picked by line
+static void append_line(std::string &text, const SettingEntry &entry, long line)
+{
+	if (line % 16 == 0)
+		text += "# A comment about the settings below\n";
+	else if (line % 16 == 8)
+		text += "\n";
+
+	text += entry.name;
+	text += line % 2 == 0 ? " = " : "\t";
+	switch (entry.def.type)
+	{
+	case ST_CHAR:
+		text += 'k';
+		break;
+	case ST_STRING:
+		text += line % 4 < 2 ? "\"a \\\"quoted\\\" value\"" : "an unquoted value";
+		break;
+	default:
+		text += std::to_string(line % 100);
+		break;
+	}
+	if (line % 3 == 0)
+		text += "  # trailing comment";
+	text += '\n';
+}
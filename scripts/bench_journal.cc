@@ -0,0 +1,94 @@
+/*
+ * bench_journal.cc measures what writing a journal entry costs with each journal setting.
+ *
+ * usage: build/linux/scripts/bench_journal [entries]
+ *
+ * The journal is written in a temporary $XDG_STATE_HOME, so the journal of a running pomocom isn't affected. For each setting, entries alternate between running and paused like pausing and resuming does, and the journal is read back afterwards to check that it holds the last entry:
+ * fsync never		Appending with a compaction every 64 entries, the default
+ * compact always	A compaction on every entry (compact_after 0)
+ * fsync always		Appending with fdatasync() after each entry
+ * The temporary directory is on /tmp, so the fsync numbers depend on what /tmp is.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>	// For std::atol(), mkdtemp(), and setenv()
+#include <string>
+
+#include <unistd.h>
+
+#include "journal.hh"
+#include "settings.hh"
+#include "state.hh"
+
+using namespace pomocom;
+
+// Writes entries journal entries with fsync and compact_after and returns the secs per entry
+// Returns -1 if the journal doesn't read back as the last entry written
+static double bench_write(long entries, SettingInt fsync, SettingShort compact_after);
+
+int main(int argc, char **argv)
+{
+	long entries = argc > 1 ? std::atol(argv[1]) : 2000;
+
+	// Make the last entry a paused one, so it can be checked against the # of entries
+	if (entries < 2)
+		entries = 2;
+	entries += entries % 2;
+
+	char dir[] = "/tmp/pomocom-bench-XXXXXX";
+	if (mkdtemp(dir) == nullptr)
+	{
+		std::perror("bench_journal: mkdtemp");
+		return EXIT_FAILURE;
+	}
+	setenv("XDG_STATE_HOME", dir, 1);
+
+	double never = bench_write(entries, JOURNAL_FSYNC_NEVER, 64);
+	double compact = bench_write(entries, JOURNAL_FSYNC_NEVER, 0);
+	double always = bench_write(entries, JOURNAL_FSYNC_ALWAYS, 64);
+
+	std::string path = std::string(dir) + "/pomocom";
+	unlink((path + "/journal").c_str());
+	unlink((path + "/journal.lock").c_str());
+	rmdir(path.c_str());
+	rmdir(dir);
+
+	if (never < 0 || compact < 0 || always < 0)
+	{
+		std::fprintf(stderr, "bench_journal: the journal didn't hold the last entry written\n");
+		return EXIT_FAILURE;
+	}
+	std::printf("fsync never: %.1f us per entry\n", never * 1e6);
+	std::printf("compact always: %.1f us per entry\n", compact * 1e6);
+	std::printf("fsync always: %.1f us per entry\n", always * 1e6);
+	return EXIT_SUCCESS;
+}
+
+// Writes entries journal entries with fsync and compact_after and returns the secs per entry
+// Returns -1 if the journal doesn't read back as the last entry written
+static double bench_write(long entries, SettingInt fsync, SettingShort compact_after)
+{
+	state.settings.journal.fsync = fsync;
+	state.settings.journal.compact_after = compact_after;
+	journal_open("bench");
+
+	auto end = std::chrono::steady_clock::now() + std::chrono::minutes(25);
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < entries; ++i)
+	{
+		if (i % 2 == 0)
+			journal_write_running(i % 8, end);
+		else
+			journal_write_paused(i % 8, i);
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	journal_close();
+
+	// entries is even, so the last entry is paused
+	long last = entries - 1;
+	JournalState js;
+	if (!journal_read(js) || js.file_name != "bench" || !js.paused || js.secs_left != last || js.section != (std::size_t) last % 8)
+		return -1;
+	return secs / entries;
+}
@@ -0,0 +1,108 @@
+/*
+ * bench_settings.cc compares setting_find() with the std::unordered_map that settings used to be looked up in.
+ *
+ * usage: build/linux/scripts/bench_settings [lookups in millions]
+ *
+ * The map is built from settings_map like the old one was built on startup, and the time that takes is printed too. Both are then asked for every setting name and for as many names that don't exist, in a shuffled order, and the best of 5 runs is printed in ns per lookup.
+ */
+
+#include <algorithm>	// For std::shuffle()
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>	// For std::atof()
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>	// For std::move()
+#include <vector>
+
+#include "settings.hh"
+
+using namespace pomocom;
+
+using SettingMap = std::unordered_map<std::string_view, const SettingDef *>;
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start);
+
+// Looks up every name in names lookups times in total with find, and returns the ns per lookup
+// hits counts the names that were found, so the lookups can't be optimized away
+template <typename Find>
+static double bench_find(const std::vector<std::string_view> &names, long lookups, long &hits, Find find);
+
+int main(int argc, char **argv)
+{
+	long lookups = (argc > 1 ? std::atof(argv[1]) : 10) * 1e6;
+
+	// Time building the map
+	double build = 1e9;
+	SettingMap map;
+	for (int run = 0; run < 5; ++run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		SettingMap m;
+		for (const SettingEntry &entry : settings_map)
+			m.emplace(entry.name, &entry.def);
+		double t = secs_since(start);
+		build = t < build ? t : build;
+		map = std::move(m);
+	}
+
+	// Every setting name, and names that miss by one char
+	std::vector<std::string> misses;
+	for (const SettingEntry &entry : settings_map)
+	{
+		std::string name(entry.name);
+		name.back() ^= 1;
+		misses.push_back(std::move(name));
+	}
+	std::vector<std::string_view> names;
+	for (const SettingEntry &entry : settings_map)
+		names.push_back(entry.name);
+	for (const std::string &name : misses)
+		names.push_back(name);
+	std::shuffle(names.begin(), names.end(), std::mt19937(1));
+
+	long table_hits = 0, map_hits = 0;
+	double table = bench_find(names, lookups, table_hits, setting_find);
+	double hashed = bench_find(names, lookups, map_hits, [&map](std::string_view name) -> const SettingDef *
+		{
+			auto it = map.find(name);
+			return it == map.end() ? nullptr : it->second;
+		});
+	if (table_hits != map_hits)
+	{
+		std::fprintf(stderr, "bench_settings: setting_find() and the map found different settings\n");
+		return EXIT_FAILURE;
+	}
+
+	std::printf("%zu settings, building the map took %.2f us\n", settings_map.size(), build * 1e6);
+	std::printf("setting_find(): %.1f ns per lookup\n", table);
+	std::printf("std::unordered_map: %.1f ns per lookup\n", hashed);
+	return EXIT_SUCCESS;
+}
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Looks up every name in names lookups times in total with find, and returns the ns per lookup
+// hits counts the names that were found, so the lookups can't be optimized away
+template <typename Find>
+static double bench_find(const std::vector<std::string_view> &names, long lookups, long &hits, Find find)
+{
+	double best = 1e9;
+	for (int run = 0; run < 5; ++run)
+	{
+		hits = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (long i = 0; i < lookups; ++i)
+			hits += find(names[i % names.size()]) != nullptr;
+		double t = secs_since(start);
+		best = t < best ? t : best;
+	}
+	return best / lookups * 1e9;
+}
@@ -0,0 +1,97 @@
+#!/bin/sh
+# bench_startup.sh runs pomocom --profile-startup many times and prints percentiles of each startup phase
+#
+# usage: scripts/bench_startup.sh [-n runs] [-b pomocom binary] [-d] [pomocom args...]
+#
+# Cold starts are run with an empty config cache.
+# With -d, the page cache is also dropped before each cold start, which needs root and slows down everything else on the machine.
+# Warm starts are run after a start that fills the config cache.
+# The cache, journal, history, status page, and control socket are kept in a temporary directory so that a running pomocom isn't affected.
+# "exec to exit" is the wall clock time of the whole process measured from outside it, which includes starting script(1) to get a pseudo terminal.
+
+runs=50
+bin=./pomocom
+drop_caches=no
+while getopts n:b:d opt; do
+	case $opt in
+	n) runs=$OPTARG ;;
+	b) bin=$OPTARG ;;
+	d) drop_caches=yes ;;
+	*) echo "usage: $0 [-n runs] [-b pomocom binary] [-d] [pomocom args...]" >&2; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $drop_caches = yes ] && [ ! -w /proc/sys/vm/drop_caches ]; then
+	echo "$0: -d needs write access to /proc/sys/vm/drop_caches (run as root)" >&2
+	exit 1
+fi
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+export XDG_CACHE_HOME="$tmp/cache" XDG_STATE_HOME="$tmp/state" XDG_RUNTIME_DIR="$tmp/run"
+mkdir -p "$XDG_RUNTIME_DIR"
+
+# Runs pomocom once in a pseudo terminal with args $2... and appends its phase times to file $1
+run_once()
+{
+	out_file=$1
+	shift
+	start=$(date +%s%N)
+	script -qec "$bin $* --profile-startup" /dev/null >"$tmp/out" 2>&1 </dev/null
+	end=$(date +%s%N)
+
+	tr -d '\r' <"$tmp/out" | awk -v wall="$(( (end - start) / 1000 ))" '
+		found && $NF ~ /^[0-9.]+$/ && $(NF - 1) ~ /^[0-9.]+$/ { name = $1; for (i = 2; i <= NF - 2; ++i) name = name " " $i; print name "\t" $(NF - 1) }
+		/^.*phase +us +total us$/ { found = 1 }
+		END { print "exec to exit\t" wall }' >>"$out_file"
+}
+
+# Prints percentiles of the phase times in file $1
+report()
+{
+	awk -F '\t' '
+		!($1 in n) { order[++phases] = $1 }
+		{ v[$1, ++n[$1]] = $2 }
+		function pct(name, p,    i) { i = int(n[name] * p + 0.999999); return v[name, i < 1 ? 1 : i] }
+		END {
+			printf "%-28s %10s %10s %10s %10s\n", "phase (us)", "p50", "p90", "p99", "max"
+			for (k = 1; k <= phases; ++k) {
+				name = order[k]
+				# Insertion sort, there are only a few hundred samples per phase
+				for (i = 2; i <= n[name]; ++i)
+					for (j = i; j > 1 && v[name, j - 1] + 0 > v[name, j] + 0; --j) {
+						t = v[name, j]; v[name, j] = v[name, j - 1]; v[name, j - 1] = t
+					}
+				printf "%-28s %10.1f %10.1f %10.1f %10.1f\n", name, pct(name, 0.5), pct(name, 0.9), pct(name, 0.99), v[name, n[name]]
+			}
+		}' "$1"
+}
+
+echo "cold starts ($runs runs)"
+: >"$tmp/cold"
+i=0
+while [ $i -lt "$runs" ]; do
+	rm -rf "$XDG_CACHE_HOME"
+	if [ $drop_caches = yes ]; then
+		sync
+		echo 3 >/proc/sys/vm/drop_caches
+	fi
+	run_once "$tmp/cold" "$@"
+	i=$((i + 1))
+done
+report "$tmp/cold"
+
+echo
+echo "warm starts ($runs runs)"
+
+# Fill the config cache with a start that isn't reported
+: >"$tmp/prime"
+run_once "$tmp/prime" "$@"
+: >"$tmp/warm"
+i=0
+while [ $i -lt "$runs" ]; do
+	run_once "$tmp/warm" "$@"
+	i=$((i + 1))
+done
+report "$tmp/warm"
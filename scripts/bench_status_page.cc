@@ -0,0 +1,98 @@
+/*
+ * bench_status_page.cc measures how fast the status page can be read, with and without a writer updating it.
+ *
+ * usage: build/linux/scripts/bench_status_page [secs per test]
+ *
+ * The page is created in a temporary $XDG_RUNTIME_DIR, so a running pomocom isn't affected. In the contended test, a writer thread rewrites the page nonstop with a name and a paused secs left that always match, and the reader fails if it ever sees them not match.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>	// For std::atof(), mkdtemp(), and setenv()
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "status_page.hh"
+
+using namespace pomocom;
+
+// Reads the page for secs secs and returns the # of reads per sec
+// Returns -1 if a torn snapshot was read
+static double bench_read(const StatusPage &page, double secs);
+
+int main(int argc, char **argv)
+{
+	double secs = argc > 1 ? std::atof(argv[1]) : 1;
+
+	char dir[] = "/tmp/pomocom-bench-XXXXXX";
+	if (mkdtemp(dir) == nullptr)
+	{
+		std::perror("bench_status_page: mkdtemp");
+		return EXIT_FAILURE;
+	}
+	setenv("XDG_RUNTIME_DIR", dir, 1);
+
+	status_page_open();
+	status_page_write(0, "0", true, 0, {});
+	const StatusPage *page = status_page_map();
+	if (page == nullptr)
+	{
+		std::fprintf(stderr, "bench_status_page: failed to map the status page\n");
+		return EXIT_FAILURE;
+	}
+
+	double uncontended = bench_read(*page, secs);
+
+	// Keep the writer busy until the reader is done
+	std::atomic<bool> done = false;
+	long writes = 0;
+	std::thread writer([&done, &writes]
+		{
+			for (int i = 0; !done.load(std::memory_order_relaxed); i = (i + 1) % 100000)
+			{
+				status_page_write(i % 3, std::to_string(i).c_str(), true, i, {});
+				++writes;
+			}
+		});
+	double contended = bench_read(*page, secs);
+	done = true;
+	writer.join();
+
+	status_page_unmap(page);
+	status_page_close();
+	rmdir(dir);
+
+	if (uncontended < 0 || contended < 0)
+	{
+		std::fprintf(stderr, "bench_status_page: read a torn snapshot\n");
+		return EXIT_FAILURE;
+	}
+	std::printf("uncontended: %.1fM reads/s\n", uncontended / 1e6);
+	std::printf("with a writer: %.1fM reads/s, %.1fM writes/s, no torn snapshots\n", contended / 1e6, writes / secs / 1e6);
+	return EXIT_SUCCESS;
+}
+
+// Reads the page for secs secs and returns the # of reads per sec
+// Returns -1 if a torn snapshot was read
+static double bench_read(const StatusPage &page, double secs)
+{
+	auto start = std::chrono::steady_clock::now();
+	auto end = start + std::chrono::duration<double>(secs);
+	long reads = 0;
+	StatusSnapshot snap;
+	while (std::chrono::steady_clock::now() < end)
+	{
+		// Check the clock every 1024 reads so that it isn't most of what is measured
+		for (int i = 0; i < 1024; ++i)
+		{
+			status_page_read(page, snap);
+			if (std::atoi(snap.name) != snap.secs_left || snap.secs_left % 3 != snap.section)
+				return -1;
+		}
+		reads += 1024;
+	}
+	return reads / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
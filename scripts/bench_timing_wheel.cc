@@ -0,0 +1,163 @@
+/*
+ * bench_timing_wheel.cc compares TimingWheel with the std::priority_queue the daemon used before it.
+ *
+ * usage: build/linux/scripts/bench_timing_wheel [runs]
+ *
+ * For 1k, 100k, and 1M timers with random deadlines in the next 25 minutes (in millisecond ticks, like the daemon uses), it times:
+ * insert and drain	Scheduling every timer and then expiring all of them
+ * reschedule		Moving every scheduled timer to a new deadline, as pausing and resuming a session does, and then expiring all of them
+ * The heap can't move an entry, so like the daemon's old heap it pushes a new entry and skips stale ones when they are popped.
+ * Both check that every timer expires once, on its latest deadline, and in deadline order. The best of the runs is printed.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>	// For std::atoi()
+#include <functional>	// For std::greater
+#include <memory>	// For std::make_unique()
+#include <queue>
+#include <random>
+#include <utility>	// For std::pair
+#include <vector>
+
+#include "timing_wheel.hh"
+
+using namespace pomocom;
+
+// Ticks that deadlines are spread over
+constexpr std::uint64_t BENCH_SPAN = 25 * 60 * 1000;
+
+// Timer with an id so expiry order can be compared
+struct BenchTimer : WheelTimer{
+	std::uint32_t id;
+};
+
+// Entry of the heap: (deadline, id)
+using HeapEntry = std::pair<std::uint64_t, std::uint32_t>;
+using Heap = std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>>;
+
+// Sum of the expiry tick times (id + 1) of each expired timer, compared between the wheel and the heap
+static std::uint64_t checksum;
+
+// Set if a timer expired before one it was scheduled after
+static bool out_of_order;
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start);
+
+// Schedules a timer for each deadline in the wheel, expires them all, and returns the secs taken
+static double bench_wheel(const std::vector<std::uint64_t> &deadlines, const std::vector<std::uint64_t> *moved);
+
+// Does the same with a heap and returns the secs taken
+static double bench_heap(const std::vector<std::uint64_t> &deadlines, const std::vector<std::uint64_t> *moved);
+
+int main(int argc, char **argv)
+{
+	int runs = argc > 1 ? std::atoi(argv[1]) : 5;
+	std::mt19937_64 rng(1);
+
+	std::printf("%-10s %-18s %12s %12s\n", "timers", "test", "wheel ms", "heap ms");
+	for (std::size_t n : {1000u, 100000u, 1000000u})
+	{
+		std::vector<std::uint64_t> deadlines(n), moved(n);
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			deadlines[i] = 1 + rng() % BENCH_SPAN;
+			moved[i] = 1 + rng() % BENCH_SPAN;
+		}
+
+		for (bool reschedule : {false, true})
+		{
+			const std::vector<std::uint64_t> *m = reschedule ? &moved : nullptr;
+			double wheel = 1e9, heap = 1e9;
+			for (int run = 0; run < runs; ++run)
+			{
+				checksum = 0;
+				out_of_order = false;
+				double t = bench_wheel(deadlines, m);
+				wheel = t < wheel ? t : wheel;
+				std::uint64_t wheel_sum = checksum;
+
+				checksum = 0;
+				t = bench_heap(deadlines, m);
+				heap = t < heap ? t : heap;
+				if (checksum != wheel_sum || out_of_order)
+				{
+					std::fprintf(stderr, "bench_timing_wheel: the wheel expired timers at the wrong ticks\n");
+					return EXIT_FAILURE;
+				}
+			}
+			std::printf("%-10zu %-18s %12.2f %12.2f\n", n, reschedule ? "reschedule" : "insert and drain", wheel * 1e3, heap * 1e3);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// Returns the secs since start
+static double secs_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Schedules a timer for each deadline in the wheel, expires them all, and returns the secs taken
+static double bench_wheel(const std::vector<std::uint64_t> &deadlines, const std::vector<std::uint64_t> *moved)
+{
+	std::vector<BenchTimer> timers(deadlines.size());
+	auto wheel = std::make_unique<TimingWheel>();
+	std::uint64_t last = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < timers.size(); ++i)
+	{
+		timers[i].id = i;
+		wheel->insert(timers[i], deadlines[i]);
+	}
+	if (moved != nullptr)
+		for (std::size_t i = 0; i < timers.size(); ++i)
+			wheel->insert(timers[i], (*moved)[i]);
+	TimingWheel &w = *wheel;
+	w.advance(BENCH_SPAN + 1, [&w, &last](WheelTimer &t)
+		{
+			if (w.now() < last)
+				out_of_order = true;
+			last = w.now();
+			checksum += w.now() * (static_cast<BenchTimer &>(t).id + 1);
+		});
+	return secs_since(start);
+}
+
+// Does the same with a heap and returns the secs taken
+static double bench_heap(const std::vector<std::uint64_t> &deadlines, const std::vector<std::uint64_t> *moved)
+{
+	std::vector<std::uint64_t> current(deadlines.size());
+	Heap heap;
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < deadlines.size(); ++i)
+	{
+		current[i] = deadlines[i];
+		heap.emplace(deadlines[i], i);
+	}
+	if (moved != nullptr)
+	{
+		for (std::size_t i = 0; i < deadlines.size(); ++i)
+		{
+			current[i] = (*moved)[i];
+			heap.emplace((*moved)[i], i);
+		}
+	}
+
+	while (!heap.empty())
+	{
+		auto [expires, id] = heap.top();
+		heap.pop();
+
+		// Skip entries left behind by rescheduling, including one with the same deadline as the new entry
+		if (expires != current[id])
+			continue;
+		current[id] = TimingWheel::NEVER;
+		checksum += expires * (id + 1);
+	}
+	return secs_since(start);
+}
@@ -0,0 +1,212 @@
+/*
+ * test_frame.cc checks how many bytes FrameBuffer sends for each tick of a section.
+ *
+ * usage: build/linux/scripts/test_frame
+ *
+ * It builds frames like the ANSI interface does, for every tick of a 25 minute section, and checks the output of each render:
+ * A tick where only the last digit changes sends at most 5 bytes, and exactly 4 (ESC[D and the digit) if the tick before it did the same
+ * A frame that didn't change sends nothing
+ * Replaying all of the output on a small emulated terminal gives the frame that was built
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "interface/frame.hh"
+#include "interface/tick.hh"
+
+using namespace pomocom;
+
+// Rows of the frame, like the ANSI interface uses
+enum{
+	ROW_HEADER,
+	ROW_SECTION,
+	ROW_TIME,
+	ROW_COUNT,
+};
+
+// Terminal that understands the escape sequences FrameBuffer sends
+struct TestTerminal{
+	std::vector<std::string> rows = std::vector<std::string>(ROW_COUNT);
+	int row = 0;
+	int col = 0;
+};
+
+// # of failed checks
+static int failures;
+
+// Prints msg and counts a failure if ok is false
+static void check(bool ok, int tick, const char *msg);
+
+// Puts the rows of a frame showing mins and secs left
+static void put_time(FrameBuffer &frame, int mins, int secs, bool paused);
+
+// Applies out to *term
+static void term_apply(TestTerminal &term, std::string_view out);
+
+// Returns true if *term shows the header, section, and time rows
+static bool term_shows(const TestTerminal &term, int mins, int secs, bool paused);
+
+int main()
+{
+	FrameBuffer frame;
+	TestTerminal term;
+
+	// Output is checked with output() and then thrown away
+	int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+	// The first render clears the screen and draws everything
+	put_time(frame, 25, 0, false);
+	frame.render();
+	check(frame.output().starts_with("\033[2J\033[H"), -1, "the first render doesn't clear the screen");
+	term_apply(term, frame.output());
+	check(term_shows(term, 25, 0, false), -1, "the first render doesn't draw the frame");
+	frame.flush(null_fd);
+
+	// True if the last tick only changed the last digit, leaving the cursor right after it
+	bool last_one_digit = false;
+	int secs_left = 25 * 60 - 1;
+	for (int tick = 0; secs_left >= 0; ++tick, --secs_left)
+	{
+		int mins = secs_left / 60, secs = secs_left % 60;
+		put_time(frame, mins, secs, false);
+		frame.render();
+		std::string_view out = frame.output();
+		term_apply(term, out);
+		check(term_shows(term, mins, secs, false), tick, "the screen doesn't match the frame");
+
+		// Only the last digit changes unless secs wraps, mins changes, or the row gets shorter
+		bool one_digit = secs % 10 != 9 && secs != 9;
+		if (one_digit)
+		{
+			check(out.size() <= 5, tick, "a tick changing one digit sent more than 5 bytes");
+			if (last_one_digit)
+				check(out.substr(0, 3) == "\033[D" && out.size() == 4, tick, "a tick changing one digit isn't ESC[D and the digit");
+		}
+		last_one_digit = one_digit;
+		if (secs == 9)
+			check(out.ends_with("\033[K"), tick, "a tick shortening the row doesn't erase the rest of it");
+		frame.flush(null_fd);
+
+		// Redrawing the same frame sends nothing
+		put_time(frame, mins, secs, false);
+		frame.render();
+		check(frame.output().empty(), tick, "an unchanged frame sent output");
+		frame.flush(null_fd);
+	}
+
+	// Pausing only moves past the 's' and appends to the time row
+	put_time(frame, 0, 0, true);
+	frame.render();
+	term_apply(term, frame.output());
+	check(term_shows(term, 0, 0, true), -1, "the screen doesn't match the paused frame");
+	check(frame.output() == "\033[C (paused)", -1, "pausing sent more than the appended text");
+	frame.flush(null_fd);
+	close(null_fd);
+
+	if (failures > 0)
+	{
+		std::fprintf(stderr, "test_frame: %d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	std::printf("test_frame: ok\n");
+	return EXIT_SUCCESS;
+}
+
+// Prints msg and counts a failure if ok is false
+static void check(bool ok, int tick, const char *msg)
+{
+	if (ok)
+		return;
+	std::fprintf(stderr, "test_frame: tick %d: %s\n", tick, msg);
+	++failures;
+}
+
+// Puts the rows of a frame showing mins and secs left
+static void put_time(FrameBuffer &frame, int mins, int secs, bool paused)
+{
+	char time[TICK_TIME_LEN_MAX];
+	int len = tick_format_time(time, mins, secs);
+	std::string text(time, len);
+	if (paused)
+		text += " (paused)";
+
+	frame.clear();
+	frame.put(ROW_HEADER, "pomocom: test");
+	frame.put(ROW_SECTION, "work");
+	frame.put(ROW_TIME, text);
+}
+
+// Applies out to *term
+static void term_apply(TestTerminal &term, std::string_view out)
+{
+	for (std::size_t i = 0; i < out.size();)
+	{
+		char c = out[i++];
+		if (c == '\r')
+		{
+			term.col = 0;
+			continue;
+		}
+		if (c != '\033')
+		{
+			std::string &row = term.rows[term.row];
+			if ((int) row.size() <= term.col)
+				row.resize(term.col + 1, ' ');
+			row[term.col++] = c;
+			continue;
+		}
+
+		// Escape sequence: ESC [ (numbers separated by ;) (final char)
+		++i;
+		int args[2] = {0, 0}, nargs = 0;
+		while (out[i] >= '0' && out[i] <= '9')
+		{
+			args[nargs] = args[nargs] * 10 + out[i++] - '0';
+			if (out[i] == ';')
+			{
+				++nargs;
+				++i;
+			}
+		}
+		int n = args[0] > 0 ? args[0] : 1;
+		switch (out[i++])
+		{
+		case 'H':
+			term.row = args[0] > 0 ? args[0] - 1 : 0;
+			term.col = args[1] > 0 ? args[1] - 1 : 0;
+			break;
+		case 'C':
+			term.col += n;
+			break;
+		case 'D':
+			term.col -= n;
+			break;
+		case 'K':
+			if ((int) term.rows[term.row].size() > term.col)
+				term.rows[term.row].resize(term.col);
+			break;
+		case 'J':
+			for (std::string &row : term.rows)
+				row.clear();
+			break;
+		}
+	}
+}
+
+// Returns true if *term shows the header, section, and time rows
+static bool term_shows(const TestTerminal &term, int mins, int secs, bool paused)
+{
+	char time[TICK_TIME_LEN_MAX];
+	int len = tick_format_time(time, mins, secs);
+	std::string text(time, len);
+	if (paused)
+		text += " (paused)";
+	return term.rows[ROW_HEADER] == "pomocom: test" && term.rows[ROW_SECTION] == "work" && term.rows[ROW_TIME] == text;
+}
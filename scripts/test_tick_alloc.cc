@@ -0,0 +1,218 @@
+/*
+ * test_tick_alloc.cc checks that a steady-state tick of the terminal interfaces doesn't allocate.
+ *
+ * usage: build/linux/scripts/test_tick_alloc
+ *
+ * Global operator new is replaced with one that counts calls. Each terminal interface is then run through its real loop (interface_ansi_loop(), and the ncurses one if pomocom was built with it) on a virtual clock, so the reactor jumps straight to every tick of a 25 minute section (see reactor.hh). Each tick goes through TermLoop::update(): computing the time left and the next update, printing it with the interface's TermView, setting the terminal title, and flushing the screen. The interface runs on a pseudoterminal that is drained by another thread, and the section command of the next section ends the loop with SIGTERM.
+ *
+ * The first minute warms up buffers that are kept between ticks, and every tick after it must make no allocations. Allocations made by ncurses itself use malloc() and aren't counted, only those made by pomocom.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "command.hh"
+#include "interface/all.hh"
+#include "interface/module.hh"
+#include "interface/tick.hh"
+#include "pomo.hh"
+#include "state.hh"
+
+using namespace pomocom;
+
+// Virtual time that the loops start at, and the range of ticks after warming up
+static const auto time_start = Clock::time_point(std::chrono::hours(1));
+static const auto time_warm = time_start + std::chrono::minutes(1);
+static const auto time_end = time_start + std::chrono::minutes(25);
+
+// # of calls to operator new during steady-state ticks
+static long allocations;
+
+// True once the section command of the section after the timed one was run
+static bool section_ended;
+
+void *operator new(std::size_t size)
+{
+	if (clock_virtual && clock_virtual_now >= time_warm && clock_virtual_now < time_end)
+		++allocations;
+	if (void *p = std::malloc(size > 0 ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+// Ends the interface loop when the timed section is over
+static void end_loop(const char *cmd);
+
+// Runs the loop of an interface through one section on a pseudoterminal
+// Returns false if it failed
+static bool run(const char *name, void (*loop)());
+
+#if defined(POMOCOM_NCURSES_MODULE)
+// Loads the ncurses module built next to pomocom and runs its loop
+static void ncurses_module_loop();
+#endif
+
+int main()
+{
+	// A pomo file with one section per kind, so the timed section is always followed by another
+	char dir[] = "/tmp/pomocom-test-XXXXXX";
+	if (mkdtemp(dir) == nullptr)
+	{
+		std::perror("test_tick_alloc: mkdtemp");
+		return EXIT_FAILURE;
+	}
+	std::string pomo = std::string(dir) + "/tick";
+	std::FILE *f = std::fopen((pomo + ".pomo").c_str(), "w");
+	if (f == nullptr)
+	{
+		std::perror("test_tick_alloc: failed to write the pomo file");
+		return EXIT_FAILURE;
+	}
+	std::fputs("work\n+end\n25m0s\n\nbreak\n+end\n5m0s\n\nlong\n+end\n15m0s\n", f);
+	std::fclose(f);
+	pomo_read(pomo.c_str(), state.sections);
+	state.file_name = pomo.c_str();
+
+	// The control socket is made in the temporary directory, so a running pomocom isn't affected
+	setenv("XDG_RUNTIME_DIR", dir, 1);
+	setenv("TERM", "xterm", 1);
+	state.settings.update_interval = 1;
+	state.settings.pause_before_section_start = false;
+	state.settings.set_terminal_title_countdown = true;
+	command_set_recorder(end_loop);
+
+	bool ok = run("ansi", interface_ansi_loop);
+#if defined(POMOCOM_NCURSES_STATIC)
+	ok = run("ncurses", interface_ncurses_loop) && ok;
+#elif defined(POMOCOM_NCURSES_MODULE)
+	ok = run("ncurses", ncurses_module_loop) && ok;
+#endif
+
+	unlink((pomo + ".pomo").c_str());
+	rmdir(dir);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Ends the interface loop when the timed section is over
+static void end_loop(const char *)
+{
+	section_ended = true;
+	raise(SIGTERM);
+}
+
+// Runs the loop of an interface through one section on a pseudoterminal
+// Returns false if it failed
+static bool run(const char *name, void (*loop)())
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1)
+	{
+		std::perror("test_tick_alloc: failed to open a pseudoterminal");
+		return false;
+	}
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	struct winsize ws = {24, 80, 0, 0};
+	ioctl(slave, TIOCSWINSZ, &ws);
+
+	// Drain the output so writing to the terminal never blocks
+	long output = 0;
+	std::thread drain([master, &output]
+		{
+			char buf[4096];
+			for (ssize_t n; (n = read(master, buf, sizeof(buf))) > 0;)
+				output += n;
+		});
+
+	int stdin_fd = dup(STDIN_FILENO);
+	int stdout_fd = dup(STDOUT_FILENO);
+	dup2(slave, STDIN_FILENO);
+	dup2(slave, STDOUT_FILENO);
+
+	allocations = 0;
+	section_ended = false;
+	state.current_section = 0;
+	state.current_section_secs = state.sections[0].secs;
+	clock_set_virtual(time_start);
+	bool threw = false;
+	try{ loop(); }
+	catch (...)
+	{
+		threw = true;
+	}
+	auto time_stopped = Clock::now();
+	clock_virtual = false;
+
+	// Closing every descriptor of the slave makes the drain thread's read() fail
+	dup2(stdin_fd, STDIN_FILENO);
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdin_fd);
+	close(stdout_fd);
+	close(slave);
+	drain.join();
+	close(master);
+
+	long ticks = std::chrono::duration_cast<std::chrono::seconds>(time_end - time_warm).count();
+	if (threw || !section_ended || time_stopped < time_end || output == 0)
+	{
+		std::fprintf(stderr, "test_tick_alloc: %s: the loop didn't run through the section\n", name);
+		return false;
+	}
+	if (allocations != 0)
+	{
+		std::fprintf(stderr, "test_tick_alloc: %s: %ld allocations in %ld steady-state ticks\n", name, allocations, ticks);
+		return false;
+	}
+	std::printf("test_tick_alloc: %s: ok, 0 allocations in %ld steady-state ticks\n", name, ticks);
+	return true;
+}
+
+#if defined(POMOCOM_NCURSES_MODULE)
+// Loads the ncurses module built next to pomocom and runs its loop
+static void ncurses_module_loop()
+{
+	// Tests are run from the project directory, where the module is built
+	void *handle = dlopen("./pomocom-ncurses.so", RTLD_NOW | RTLD_LOCAL);
+	auto loop = handle == nullptr ? nullptr : reinterpret_cast<void (*)()>(dlsym(handle, MODULE_LOOP_SYMBOL));
+	if (loop == nullptr)
+	{
+		std::fprintf(stderr, "test_tick_alloc: failed to load the ncurses module: %s\n", dlerror());
+		throw 0;
+	}
+	loop();
+}
+#endif
@@ -0,0 +1,194 @@
+/*
+ * cache.cc contains functions for caching the results of parsing config files.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>	// For std::getenv()
+#include <cstring>	// For std::memcmp() and std::memcpy()
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hh"
+#include "fileio.hh"	// For pomocom::file_make_dirs()
+
+namespace pomocom
+{
+	// First 4 bytes of a cache file ("pcch" in little endian)
+	constexpr std::uint32_t CACHE_MAGIC = 0x68636370;
+
+	// Changed when the layout of cache files changes
+	constexpr std::uint32_t CACHE_VERSION = 2;
+
+	// Start of every cache file, followed by the cached data
+	struct CacheHeader{
+		std::uint32_t magic;
+		std::uint32_t version;
+		CacheStamp stamp;
+		std::uint64_t key;
+
+		// # of bytes of data after the header
+		std::uint64_t data_size;
+	};
+
+	// Returns the path of the cache directory, or an empty string if there isn't one
+	static std::string cache_dir();
+
+	// Returns true if caching hasn't been turned off
+	bool cache_enabled()
+	{
+		return std::getenv("POMOCOM_NO_CACHE") == nullptr;
+	}
+
+	// Gets the stamp of the file at *path and reads its contents into text
+	// Returns false if the file can't be read
+	bool cache_stamp(const char *path, CacheStamp &stamp, std::string &text)
+	{
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+		{
+			close(fd);
+			return false;
+		}
+		stamp.mtime_ns = (std::int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+		stamp.size = st.st_size;
+		stamp.ino = st.st_ino;
+		stamp.dev = st.st_dev;
+
+		// The size is known, so the file is usually read with one read(2)
+		// Reading stops at the end of the file even if it changed size since fstat()
+		text.resize(st.st_size > 0 ? st.st_size : 4096);
+		std::size_t len = 0;
+		for (;;)
+		{
+			if (len == text.size())
+				text.resize(text.size() * 2);
+			ssize_t n = read(fd, text.data() + len, text.size() - len);
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n == -1)
+			{
+				close(fd);
+				return false;
+			}
+			if (n == 0)
+				break;
+			len += n;
+		}
+		close(fd);
+		text.resize(len);
+
+		// The hash is of the bytes that were read, so a cache is never stored for contents other than the ones that were parsed
+		stamp.hash = cache_hash(text);
+		return true;
+	}
+
+	// Reads the data of cache file *name into data if it was made from a source file with stamp and key
+	// Returns false if the cache file doesn't exist or is out of date
+	bool cache_load(std::string_view name, const CacheStamp &stamp, std::uint64_t key, std::string &data)
+	{
+		if (!cache_enabled())
+			return false;
+		std::string dir = cache_dir();
+		if (dir.empty())
+			return false;
+
+		int fd = open((dir + '/' += name).c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return false;
+
+		// Read the header and the data with one read(2)
+		struct stat st;
+		std::string buf;
+		ssize_t n = -1;
+		if (fstat(fd, &st) == 0 && (std::size_t) st.st_size >= sizeof(CacheHeader))
+		{
+			buf.resize(st.st_size);
+			while ((n = read(fd, buf.data(), buf.size())) == -1 && errno == EINTR);
+		}
+		close(fd);
+		if (n != (ssize_t) buf.size() || buf.empty())
+			return false;
+
+		CacheHeader header;
+		std::memcpy(&header, buf.data(), sizeof(header));
+		if (header.magic != CACHE_MAGIC ||
+		    header.version != CACHE_VERSION ||
+		    std::memcmp(&header.stamp, &stamp, sizeof(stamp)) != 0 ||
+		    header.key != key ||
+		    header.data_size != buf.size() - sizeof(header))
+			return false;
+
+		data.assign(buf, sizeof(header));
+		return true;
+	}
+
+	// Saves data in cache file *name with stamp and key
+	// Failing to save a cache isn't an error, so nothing is printed if it fails
+	void cache_store(std::string_view name, const CacheStamp &stamp, std::uint64_t key, std::string_view data)
+	{
+		if (!cache_enabled())
+			return;
+		std::string dir = cache_dir();
+		if (dir.empty() || !file_make_dirs(dir))
+			return;
+
+		CacheHeader header;
+		std::memset(&header, 0, sizeof(header));
+		header.magic = CACHE_MAGIC;
+		header.version = CACHE_VERSION;
+		header.stamp = stamp;
+		header.key = key;
+		header.data_size = data.size();
+
+		std::string buf((const char *) &header, sizeof(header));
+		buf += data;
+
+		// Write to a temporary file and rename it so that readers never see a partly written cache
+		std::string path = dir + '/';
+		path += name;
+		std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+		int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd == -1)
+			return;
+
+		std::string_view out = buf;
+		while (!out.empty())
+		{
+			ssize_t n = write(fd, out.data(), out.size());
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			out.remove_prefix(n);
+		}
+		close(fd);
+
+		if (!out.empty() || rename(tmp_path.c_str(), path.c_str()) == -1)
+			unlink(tmp_path.c_str());
+	}
+
+	// Returns the path of the cache directory, or an empty string if there isn't one
+	static std::string cache_dir()
+	{
+		const char *cache_home = std::getenv("XDG_CACHE_HOME");
+		if (cache_home != nullptr && cache_home[0] != '\0')
+			return std::string(cache_home) + "/pomocom";
+
+		const char *home = std::getenv("HOME");
+		if (home != nullptr && home[0] != '\0')
+			return std::string(home) + "/.cache/pomocom";
+
+		return "";
+	}
+}
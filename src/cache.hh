@@ -0,0 +1,69 @@
+/*
+ * cache.hh contains functions for caching the results of parsing config files.
+ *
+ * Parsing pomocom.conf and pomo files on every launch costs more than loading what they turned into. After a file is parsed, its result is saved in a cache file in $XDG_CACHE_HOME/pomocom (or ~/.cache/pomocom) along with a stamp of the source file (its mtime, size, inode, device, and a hash of its contents) and a key. The next launch reads the source file to stamp it and loads the cache with a single read(2) if the stamp and the key still match, and parses the bytes it already read if they don't. The hash catches edits that keep the mtime and size, like ones made within the mtime's granularity or by tools that restore the mtime.
+ *
+ * The key is a hash of everything other than the source file that changes the result, like the layout of the data and default setting values. Cache files also start with a magic number and version, so a cache written by a different version of pomocom is ignored.
+ *
+ * Setting the environment variable POMOCOM_NO_CACHE turns caching off.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace pomocom
+{
+	// Identifies a version of a source file
+	struct CacheStamp{
+		std::int64_t mtime_ns;
+		std::int64_t size;
+		std::uint64_t ino;
+		std::uint64_t dev;
+
+		// cache_hash() of the file's contents
+		std::uint64_t hash;
+	};
+
+	// Starting value of cache_hash()
+	constexpr std::uint64_t CACHE_HASH_START = 14695981039346656037u;
+
+	// Returns the FNV-1a hash of *data continued from h
+	constexpr std::uint64_t cache_hash(std::string_view data, std::uint64_t h = CACHE_HASH_START)
+	{
+		for (char c : data)
+		{
+			h ^= (unsigned char) c;
+			h *= 1099511628211u;
+		}
+		return h;
+	}
+
+	// Returns the hash of number n continued from h
+	constexpr std::uint64_t cache_hash_number(std::uint64_t n, std::uint64_t h = CACHE_HASH_START)
+	{
+		for (int i = 0; i < 8; ++i, n >>= 8)
+		{
+			h ^= n & 0xff;
+			h *= 1099511628211u;
+		}
+		return h;
+	}
+
+	// Returns true if caching hasn't been turned off
+	bool cache_enabled();
+
+	// Gets the stamp of the file at *path and reads its contents into text
+	// Returns false if the file can't be read
+	bool cache_stamp(const char *path, CacheStamp &stamp, std::string &text);
+
+	// Reads the data of cache file *name into data if it was made from a source file with stamp and key
+	// Returns false if the cache file doesn't exist or is out of date
+	bool cache_load(std::string_view name, const CacheStamp &stamp, std::uint64_t key, std::string &data);
+
+	// Saves data in cache file *name with stamp and key
+	// Failing to save a cache isn't an error, so nothing is printed if it fails
+	void cache_store(std::string_view name, const CacheStamp &stamp, std::uint64_t key, std::string_view data);
+}
@@ -0,0 +1,160 @@
+/*
+ * command.cc contains functions for running section commands without blocking the interface loops.
+ */
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <spawn.h>	// For posix_spawn()
+#include <sys/wait.h>	// For waitpid()
+
+#include "command.hh"
+#include "error.hh"
+
+extern char **environ;
+
+namespace pomocom
+{
+	// A section command that is running
+	struct Command{
+		pid_t pid;
+
+		// Copy of the command text used in error messages
+		std::string cmd;
+	};
+
+	// Section commands that haven't been reaped yet
+	static std::vector<Command> commands;
+
+	// Called with each command instead of running it, or nullptr to run commands
+	static void (*command_recorder)(const char *cmd) = nullptr;
+
+	// Set by the SIGCHLD handler when a child process exits
+	// It is read by other threads, so it is a lock-free atomic, which is also safe to set from a signal handler
+	static std::atomic<bool> child_exited = false;
+	static_assert(std::atomic<bool>::is_always_lock_free, "child_exited must be lock-free to be set from a signal handler");
+
+	static void on_sigchld(int);
+
+	// Installs the SIGCHLD handler on the first call
+	static void install_sigchld_handler();
+
+	// Starts running *cmd in the background
+	void command_spawn(const char *cmd)
+	{
+		if (command_recorder != nullptr)
+		{
+			command_recorder(cmd);
+			return;
+		}
+
+		install_sigchld_handler();
+
+		// Don't run empty commands
+		if (cmd[0] == '\0')
+			return;
+
+		char arg0[] = "sh";
+		char arg1[] = "-c";
+		char *argv[] = {arg0, arg1, const_cast<char *>(cmd), nullptr};
+
+		// Commands shouldn't inherit the signals blocked by the reactor
+		posix_spawnattr_t attr;
+		sigset_t sigmask;
+		sigemptyset(&sigmask);
+		posix_spawnattr_init(&attr);
+		posix_spawnattr_setsigmask(&attr, &sigmask);
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+		pid_t pid;
+		int err = posix_spawn(&pid, "/bin/sh", nullptr, &attr, argv, environ);
+		posix_spawnattr_destroy(&attr);
+		if (err)
+		{
+			PERR("failed to spawn section command \"%s\" (error %d)", cmd, err);
+			return;
+		}
+
+		commands.push_back({pid, cmd});
+	}
+
+	// Reaps section commands that have exited and prints errors for nonzero exit codes
+	// This never blocks
+	void command_reap()
+	{
+		if (!child_exited.exchange(false))
+			return;
+
+		for (std::size_t i = 0; i < commands.size();)
+		{
+			Command &c = commands[i];
+
+			int status;
+			pid_t ret = waitpid(c.pid, &status, WNOHANG);
+			if (ret == 0)
+			{
+				// Still running
+				++i;
+				continue;
+			}
+
+			if (ret == -1)
+				PERR("failed to wait for section command \"%s\"", c.cmd.c_str());
+			else if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+				PERR("section command \"%s\" exited with nonzero exit code %d", c.cmd.c_str(), WEXITSTATUS(status));
+			else if (WIFSIGNALED(status))
+				PERR("section command \"%s\" was killed by signal %d", c.cmd.c_str(), WTERMSIG(status));
+
+			// Remove the command by swapping it with the last one
+			c = std::move(commands.back());
+			commands.pop_back();
+		}
+	}
+
+	// Returns the # of section commands that haven't been reaped yet
+	int command_running()
+	{
+		return commands.size();
+	}
+
+	// Marks that a section command may have exited so the next command_reap() call checks on them
+	void command_notify_exit()
+	{
+		child_exited = true;
+	}
+
+	// Returns true if a section command may have exited since the last command_reap() call
+	// This is safe to call from any thread
+	bool command_exited()
+	{
+		return child_exited;
+	}
+
+	// Makes command_spawn() pass commands to record() instead of running them, or run them again if record is nullptr
+	void command_set_recorder(void (*record)(const char *cmd))
+	{
+		command_recorder = record;
+	}
+
+	static void on_sigchld(int)
+	{
+		command_notify_exit();
+	}
+
+	// Installs the SIGCHLD handler on the first call
+	static void install_sigchld_handler()
+	{
+		static bool installed = false;
+		if (installed)
+			return;
+
+		struct sigaction sa{};
+		sa.sa_handler = on_sigchld;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+		if (sigaction(SIGCHLD, &sa, nullptr) == -1)
+			PERR("failed to install SIGCHLD handler");
+		installed = true;
+	}
+}
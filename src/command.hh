@@ -0,0 +1,30 @@
+/*
+ * command.hh contains functions for running section commands without blocking the interface loops.
+ *
+ * Section commands are run with posix_spawn() as "/bin/sh -c (command)". The child processes are reaped in command_reap(), which is called from the interface loops. A SIGCHLD handler (or a reactor receiving SIGCHLD through its signalfd) marks when a child has exited so that command_reap() doesn't need to make any system calls on ticks where nothing happened.
+ */
+
+#pragma once
+
+namespace pomocom
+{
+	// Starts running *cmd in the background
+	void command_spawn(const char *cmd);
+
+	// Reaps section commands that have exited and prints errors for nonzero exit codes
+	// This never blocks
+	void command_reap();
+
+	// Returns the # of section commands that haven't been reaped yet
+	int command_running();
+
+	// Marks that a section command may have exited so the next command_reap() call checks on them
+	void command_notify_exit();
+
+	// Returns true if a section command may have exited since the last command_reap() call
+	// This is safe to call from any thread
+	bool command_exited();
+
+	// Makes command_spawn() pass commands to record() instead of running them, or run them again if record is nullptr
+	void command_set_recorder(void (*record)(const char *cmd));
+}
@@ -3,6 +3,13 @@
  */
 
 #include <cstdio>	// For std::FILE and std::fgetc()
+#include <string>
+
+#include <cerrno>
+#include <cstdlib>	// For std::getenv()
+
+#include <sys/stat.h>	// For fstat() and mkdir()
+#include <unistd.h>	// For write()
 
 #include "error.hh"
 #include "fileio.hh"
@@ -68,4 +75,84 @@ namespace pomocom
 			}
 		}
 	}
+
+	// Replaces the contents of buf with the whole file at *path
+	// The file is read in large blocks instead of one char at a time
+	void file_read_all(const char *path, std::string &buf)
+	{
+		SmartFilePtr sfp(path, "r");
+		auto &fp = sfp.m_fp;
+
+		// Read the file with one call when its size is known
+		struct stat st;
+		std::size_t block = 1 << 16;
+		if (fstat(fileno(fp), &st) == 0 && st.st_size > 0)
+			block = st.st_size + 1;
+
+		buf.clear();
+		for (;;)
+		{
+			std::size_t len = buf.size();
+			buf.resize(len + block);
+			std::size_t n = std::fread(buf.data() + len, 1, block, fp);
+			buf.resize(len + n);
+			if (n < block)
+				break;
+		}
+
+		if (std::ferror(fp))
+		{
+			PERR("failed to read file \"%s\"", path);
+			throw EXCEPT_IO;
+		}
+	}
+
+	// Writes all of *data to file descriptor fd, retrying short writes
+	// Returns false on error
+	bool file_write_all(int fd, std::string_view data)
+	{
+		while (!data.empty())
+		{
+			ssize_t n = write(fd, data.data(), data.size());
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data.remove_prefix(n);
+		}
+		return true;
+	}
+
+	// Returns the directory that pomocom keeps its state in ($XDG_STATE_HOME/pomocom or ~/.local/state/pomocom)
+	// Returns an empty string if neither $XDG_STATE_HOME or $HOME is set
+	std::string file_state_dir()
+	{
+		const char *state_home = std::getenv("XDG_STATE_HOME");
+		if (state_home != nullptr && state_home[0] != '\0')
+			return std::string(state_home) + "/pomocom";
+
+		const char *home = std::getenv("HOME");
+		if (home != nullptr && home[0] != '\0')
+			return std::string(home) + "/.local/state/pomocom";
+
+		return "";
+	}
+
+	// Creates the directory at *path and any of its parent directories that don't exist
+	// Returns false if it can't be created
+	bool file_make_dirs(const std::string &path)
+	{
+		if (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST)
+			return true;
+		if (errno != ENOENT)
+			return false;
+
+		// Create the parent directory first
+		std::size_t slash = path.rfind('/');
+		if (slash == std::string::npos || slash == 0 || !file_make_dirs(path.substr(0, slash)))
+			return false;
+		return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+	}
 }
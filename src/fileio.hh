@@ -5,6 +5,8 @@
 #pragma once
 
 #include <cstdio>	// For std::FILE, std::fopen(), and std::fclose()
+#include <string>
+#include <string_view>
 
 #include "error.hh"
 
@@ -30,4 +32,20 @@ namespace pomocom
 	// Writes chars from *stream (including \0) into *dest
 	// Stops when the delim character is found, and doesn't include the delim in the string
 	void spdl_readstr(char *dest, const int len_max, const int delim, std::FILE *stream);
+
+	// Replaces the contents of buf with the whole file at *path
+	// The file is read in large blocks instead of one char at a time
+	void file_read_all(const char *path, std::string &buf);
+
+	// Writes all of *data to file descriptor fd, retrying short writes
+	// Returns false on error
+	bool file_write_all(int fd, std::string_view data);
+
+	// Returns the directory that pomocom keeps its state in ($XDG_STATE_HOME/pomocom or ~/.local/state/pomocom)
+	// Returns an empty string if neither $XDG_STATE_HOME or $HOME is set
+	std::string file_state_dir();
+
+	// Creates the directory at *path and any of its parent directories that don't exist
+	// Returns false if it can't be created
+	bool file_make_dirs(const std::string &path);
 }
@@ -0,0 +1,477 @@
+/*
+ * history.cc contains functions for recording finished sections and reporting on them.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>	// For EXIT_SUCCESS and EXIT_FAILURE
+#include <cstring>	// For std::strcmp() and std::memcpy()
+#include <ctime>
+#include <map>
+#include <memory>	// For std::make_unique()
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>	// For flock()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.hh"
+#include "fileio.hh"
+#include "history.hh"
+
+namespace pomocom
+{
+	// First 4 bytes of a history file ("phst" in little endian)
+	constexpr std::uint32_t HISTORY_MAGIC = 0x74736870;
+
+	// Changed when the layout of history records changes
+	constexpr std::uint32_t HISTORY_VERSION = 1;
+
+	// # of records decoded into columns at a time by history_stats()
+	constexpr std::size_t HISTORY_CHUNK = 4096;
+
+	// Secs in a day
+	constexpr std::int64_t DAY_SECS = 24 * 60 * 60;
+
+	// Start of a history file
+	struct HistoryHeader{
+		std::uint32_t magic;
+		std::uint32_t version;
+	};
+
+	// Values of HistoryRecord::type besides section kinds
+	enum HistoryRecordType : std::uint8_t{
+		// Added to the kind of a section that was skipped
+		HR_SKIPPED = 0x10,
+
+		// Start of a block of records written by one run of pomocom for one pomo file
+		// Followed by the name of the pomo file, padded with zeros to a multiple of 8 bytes
+		HR_BLOCK = 0xff,
+	};
+
+	// A record in a history file
+	struct HistoryRecord{
+		// Kind of section (see Section in pomocom.hh) or a value of HistoryRecordType
+		std::uint8_t type;
+
+		std::uint8_t reserved;
+
+		// Secs spent in the section, or # of chars in the pomo file name for HR_BLOCK
+		std::uint16_t size;
+
+		// Secs from the record before to the end of the section, or Unix time for HR_BLOCK
+		std::uint32_t time;
+	};
+
+	static_assert(sizeof(HistoryHeader) == sizeof(HistoryRecord) && sizeof(HistoryRecord) == 8, "history records must be 8 bytes");
+
+	// Ways that "pomocom stats" groups sections
+	enum HistoryGroup{
+		HG_DAY,
+		HG_WEEK,
+		HG_FILE,
+	};
+
+	// Totals of a group of sections
+	struct HistoryTotals{
+		std::int64_t focus_secs;
+		std::int64_t break_secs;
+		std::int64_t sections;
+		std::int64_t skipped;
+	};
+
+	// A chunk of section records decoded into columns
+	struct HistoryColumns{
+		std::size_t n;
+
+		// End of the section in secs since the Unix epoch, shifted to local time
+		std::int64_t time[HISTORY_CHUNK];
+
+		// Secs spent in the section if it was a work section, otherwise 0
+		std::int32_t focus[HISTORY_CHUNK];
+
+		// Secs spent in the section if it was a break, otherwise 0
+		std::int32_t rest[HISTORY_CHUNK];
+
+		// 1 if the section was skipped, otherwise 0
+		std::int32_t skipped[HISTORY_CHUNK];
+
+		// Index of the name of the pomo file in HistoryStats::file_names
+		std::int32_t file[HISTORY_CHUNK];
+
+		// Group of each section, filled in by history_aggregate()
+		std::int64_t key[HISTORY_CHUNK];
+	};
+
+	// Data used by history_stats()
+	struct HistoryStats{
+		HistoryGroup group;
+
+		// Added to Unix times to get local times
+		std::int64_t utc_offset;
+
+		// Totals of each group
+		// Key: day # or week # since the Unix epoch, or index in file_names
+		std::map<std::int64_t, HistoryTotals> totals;
+
+		// Names of the pomo files seen so far, and their indexes
+		std::vector<std::string> file_names;
+		std::unordered_map<std::string, std::int32_t> file_ids;
+
+		HistoryColumns columns;
+	};
+
+	// Name of the pomo file being recorded, or empty if there isn't one
+	static std::string history_name;
+
+	// History file opened for appending, or -1 if it isn't open yet
+	static int history_fd = -1;
+
+	// True if writing to the history file failed, so nothing else is recorded
+	static bool history_failed = false;
+
+	// True if a block record needs to be written before the next section record
+	static bool history_block_pending = false;
+
+	// Unix time of the last record written
+	static std::int64_t history_last_time = 0;
+
+	// Size of the history file after the last record written, or -1
+	// If the file has another size, another pomocom appended to it since
+	static off_t history_end = -1;
+
+	// Opens the history file for appending and writes its header if it is new
+	// Returns false on error
+	static bool history_file_open();
+
+	// Adds the sections of history file *path to the totals in stats
+	// Returns false if the file can't be read
+	static bool history_scan(HistoryStats &stats, const char *path);
+
+	// Adds the sections in stats.columns to the totals in stats
+	static void history_aggregate(HistoryStats &stats);
+
+	// Prints the totals in stats
+	static void history_print(const HistoryStats &stats);
+
+	// Starts recording sections of the pomo file named *name
+	// The history file is opened when the first section is recorded
+	void history_open(const char *name)
+	{
+		history_name = name;
+		history_block_pending = true;
+	}
+
+	// Closes the history file
+	void history_close()
+	{
+		if (history_fd != -1)
+			close(history_fd);
+		history_fd = -1;
+		history_name.clear();
+	}
+
+	// Records that a section of kind kind ended after secs secs were spent in it
+	// skipped is true if the section was skipped instead of finishing
+	void history_record(Section kind, int secs, bool skipped)
+	{
+		if (history_name.empty() || history_failed)
+			return;
+		if (history_fd == -1 && !history_file_open())
+		{
+			PERR("failed to open the history file, sections won't be recorded");
+			history_failed = true;
+			return;
+		}
+
+		// Other pomocoms, like a wxWidgets one next to a terminal one, append to the same file
+		// Hold a lock from checking where the file ends until the record is written, so no record is a delta from another pomocom's record
+		flock(history_fd, LOCK_EX);
+		struct stat st;
+		bool stat_ok = fstat(history_fd, &st) == 0;
+		bool appended = !stat_ok || st.st_size != history_end;
+
+		// Start a new block if the time can't be stored as a delta from the last record
+		std::int64_t now = std::time(nullptr);
+		std::string buf;
+		if (history_block_pending || appended || now < history_last_time || now - history_last_time > UINT32_MAX)
+		{
+			HistoryRecord block = {};
+			block.type = HR_BLOCK;
+			block.size = history_name.size() < UINT16_MAX ? history_name.size() : UINT16_MAX;
+			block.time = now;
+			buf.append((const char *) &block, sizeof(block));
+			buf.append(history_name, 0, block.size);
+			buf.append((sizeof(HistoryRecord) - block.size % sizeof(HistoryRecord)) % sizeof(HistoryRecord), '\0');
+			history_last_time = now;
+			history_block_pending = false;
+		}
+
+		HistoryRecord r = {};
+		r.type = kind | (skipped ? HR_SKIPPED : 0);
+		r.size = secs < 0 ? 0 : secs < UINT16_MAX ? secs : UINT16_MAX;
+		r.time = now - history_last_time;
+		buf.append((const char *) &r, sizeof(r));
+		history_last_time = now;
+
+		// Write the block and the record with one write(2) so they are never split by a crash
+		bool ok = file_write_all(history_fd, buf);
+		history_end = ok && stat_ok ? st.st_size + (off_t) buf.size() : -1;
+		flock(history_fd, LOCK_UN);
+		if (!ok)
+		{
+			PERR("failed to write to the history file, sections won't be recorded");
+			history_failed = true;
+		}
+	}
+
+	// Runs "pomocom stats" with the args after "stats"
+	// usage: pomocom stats [day|week|file] [history files...]
+	// Returns the exit code
+	int history_stats(int argc, char **argv)
+	{
+		auto stats = std::make_unique<HistoryStats>();
+		stats->group = HG_DAY;
+
+		// Local time is taken to be a fixed offset from UTC, so days are split at the current offset even across DST changes
+		std::time_t now = std::time(nullptr);
+		std::tm local;
+		localtime_r(&now, &local);
+		stats->utc_offset = local.tm_gmtoff;
+
+		int i = 0;
+		if (i < argc && std::strcmp(argv[i], "day") == 0)
+			++i;
+		else if (i < argc && std::strcmp(argv[i], "week") == 0)
+		{
+			stats->group = HG_WEEK;
+			++i;
+		}
+		else if (i < argc && std::strcmp(argv[i], "file") == 0)
+		{
+			stats->group = HG_FILE;
+			++i;
+		}
+
+		bool ok = true;
+		if (i == argc)
+		{
+			// Read the history of the current user
+			std::string dir = file_state_dir();
+			if (dir.empty() || !history_scan(*stats, (dir + "/history").c_str()))
+			{
+				PERR("no history has been recorded yet");
+				return EXIT_FAILURE;
+			}
+		}
+		for (; i < argc; ++i)
+		{
+			if (!history_scan(*stats, argv[i]))
+			{
+				PERR("failed to read history file \"%s\"", argv[i]);
+				ok = false;
+			}
+		}
+
+		history_print(*stats);
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Opens the history file for appending and writes its header if it is new
+	// Returns false on error
+	static bool history_file_open()
+	{
+		std::string dir = file_state_dir();
+		if (dir.empty() || !file_make_dirs(dir))
+			return false;
+
+		history_fd = open((dir + "/history").c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (history_fd == -1)
+			return false;
+
+		// A new history file starts with the header
+		// The lock keeps two pomocoms creating the file at once from both writing it
+		flock(history_fd, LOCK_EX);
+		struct stat st;
+		bool ok = fstat(history_fd, &st) == 0;
+		if (ok && st.st_size == 0)
+		{
+			HistoryHeader header = {HISTORY_MAGIC, HISTORY_VERSION};
+			ok = file_write_all(history_fd, std::string_view((const char *) &header, sizeof(header)));
+		}
+		flock(history_fd, LOCK_UN);
+		if (!ok)
+		{
+			close(history_fd);
+			history_fd = -1;
+		}
+		return ok;
+	}
+
+	// Adds the sections of history file *path to the totals in stats
+	// Returns false if the file can't be read
+	static bool history_scan(HistoryStats &stats, const char *path)
+	{
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) == -1 || (std::size_t) st.st_size < sizeof(HistoryHeader))
+		{
+			close(fd);
+			return false;
+		}
+
+		// Map the whole file and let the kernel read it ahead as it is scanned
+		std::size_t size = st.st_size;
+		void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED)
+			return false;
+		madvise(addr, size, MADV_SEQUENTIAL);
+
+		HistoryHeader header;
+		std::memcpy(&header, addr, sizeof(header));
+		if (header.magic != HISTORY_MAGIC || header.version != HISTORY_VERSION)
+		{
+			munmap(addr, size);
+			return false;
+		}
+
+		const HistoryRecord *r = static_cast<const HistoryRecord *>(addr) + 1;
+		const HistoryRecord *end = static_cast<const HistoryRecord *>(addr) + size / sizeof(HistoryRecord);
+		HistoryColumns &c = stats.columns;
+		std::int64_t time = 0;
+		std::int32_t file = -1;
+		c.n = 0;
+		while (r < end)
+		{
+			if (r->type == HR_BLOCK)
+			{
+				// Records after a block are timed from its start and belong to its pomo file
+				std::size_t name_records = (r->size + sizeof(HistoryRecord) - 1) / sizeof(HistoryRecord);
+				if ((std::size_t) (end - r - 1) < name_records)
+					break;
+				std::string name((const char *) (r + 1), r->size);
+				auto [it, added] = stats.file_ids.emplace(name, stats.file_names.size());
+				if (added)
+					stats.file_names.push_back(std::move(name));
+				file = it->second;
+				time = r->time;
+				r += 1 + name_records;
+				continue;
+			}
+
+			// Stop at a record that wasn't fully written or isn't valid
+			int kind = r->type & ~HR_SKIPPED;
+			if (kind >= SECTION_MAX || file == -1)
+				break;
+
+			time += r->time;
+			c.time[c.n] = time + stats.utc_offset;
+			c.focus[c.n] = kind == SECTION_WORK ? r->size : 0;
+			c.rest[c.n] = kind == SECTION_WORK ? 0 : r->size;
+			c.skipped[c.n] = (r->type & HR_SKIPPED) != 0;
+			c.file[c.n] = file;
+			if (++c.n == HISTORY_CHUNK)
+			{
+				history_aggregate(stats);
+				c.n = 0;
+			}
+			++r;
+		}
+		history_aggregate(stats);
+
+		munmap(addr, size);
+		return true;
+	}
+
+	// Adds the sections in stats.columns to the totals in stats
+	static void history_aggregate(HistoryStats &stats)
+	{
+		HistoryColumns &c = stats.columns;
+		std::size_t n = c.n;
+
+		// Find the group of every section
+		switch (stats.group)
+		{
+		case HG_DAY:
+			for (std::size_t i = 0; i < n; ++i)
+				c.key[i] = c.time[i] / DAY_SECS;
+			break;
+		case HG_WEEK:
+			// Day 0 (Jan 1 1970) was a Thursday, so adding 3 makes weeks start on Monday
+			for (std::size_t i = 0; i < n; ++i)
+				c.key[i] = (c.time[i] / DAY_SECS + 3) / 7;
+			break;
+		case HG_FILE:
+			for (std::size_t i = 0; i < n; ++i)
+				c.key[i] = c.file[i];
+			break;
+		}
+
+		// Sections are in time order, so each group is a run of sections that can be summed together
+		for (std::size_t i = 0; i < n;)
+		{
+			std::size_t j = i + 1;
+			while (j < n && c.key[j] == c.key[i])
+				++j;
+
+			std::int64_t focus = 0, rest = 0, skipped = 0;
+			for (std::size_t k = i; k < j; ++k)
+			{
+				focus += c.focus[k];
+				rest += c.rest[k];
+				skipped += c.skipped[k];
+			}
+
+			HistoryTotals &t = stats.totals[c.key[i]];
+			t.focus_secs += focus;
+			t.break_secs += rest;
+			t.sections += j - i;
+			t.skipped += skipped;
+			i = j;
+		}
+	}
+
+	// Prints the totals in stats
+	static void history_print(const HistoryStats &stats)
+	{
+		static const char *group_names[] = {"day", "week of", "pomo file"};
+		std::printf("%-24s %10s %10s %9s %8s\n", group_names[stats.group], "focus", "breaks", "sections", "skipped");
+
+		HistoryTotals all = {};
+		for (const auto &[key, t] : stats.totals)
+		{
+			char label[32];
+			if (stats.group == HG_FILE)
+				std::snprintf(label, sizeof(label), "%.24s", stats.file_names[key].c_str());
+			else
+			{
+				// Weeks are labeled by the date of their Monday
+				std::time_t day_start = (stats.group == HG_DAY ? key : key * 7 - 3) * DAY_SECS;
+				std::tm tm;
+				gmtime_r(&day_start, &tm);
+				std::strftime(label, sizeof(label), "%Y-%m-%d", &tm);
+			}
+			std::printf("%-24s %6lldh%02lldm %6lldh%02lldm %9lld %8lld\n", label,
+				(long long) t.focus_secs / 3600, (long long) t.focus_secs / 60 % 60,
+				(long long) t.break_secs / 3600, (long long) t.break_secs / 60 % 60,
+				(long long) t.sections, (long long) t.skipped);
+
+			all.focus_secs += t.focus_secs;
+			all.break_secs += t.break_secs;
+			all.sections += t.sections;
+			all.skipped += t.skipped;
+		}
+		std::printf("%-24s %6lldh%02lldm %6lldh%02lldm %9lld %8lld\n", "total",
+			(long long) all.focus_secs / 3600, (long long) all.focus_secs / 60 % 60,
+			(long long) all.break_secs / 3600, (long long) all.break_secs / 60 % 60,
+			(long long) all.sections, (long long) all.skipped);
+	}
+}
@@ -0,0 +1,30 @@
+/*
+ * history.hh contains functions for recording finished sections and reporting on them.
+ *
+ * Each time a section ends or is skipped, the ANSI, ncurses, and wxWidgets interfaces append a record to $XDG_STATE_HOME/pomocom/history (or ~/.local/state/pomocom/history). Every record is 8 bytes. A block record holds the Unix time a run of pomocom started and is followed by the name of its pomo file, and each section record after it holds the section kind, whether it was skipped, the secs spent in it, and the secs since the record before it. Storing the time as a delta keeps the records small and fixed width while still covering any date. Another pomocom (such as a wxWidgets one next to a terminal one) may append to the same file, so the file is locked while a record is written, and a new block is started whenever the file grew since this pomocom's last record.
+ *
+ * "pomocom stats" scans history files and prints the focus time per day, week, or pomo file. Records are decoded a chunk at a time into columns, and since records are in time order, each group in a chunk is a run of consecutive records whose totals are summed with plain loops over the columns that the compiler vectorizes.
+ */
+
+#pragma once
+
+#include "pomocom.hh"	// For Section
+
+namespace pomocom
+{
+	// Starts recording sections of the pomo file named *name
+	// The history file is opened when the first section is recorded
+	void history_open(const char *name);
+
+	// Closes the history file
+	void history_close();
+
+	// Records that a section of kind kind ended after secs secs were spent in it
+	// skipped is true if the section was skipped instead of finishing
+	void history_record(Section kind, int secs, bool skipped);
+
+	// Runs "pomocom stats" with the args after "stats"
+	// usage: pomocom stats [day|week|file] [history files...]
+	// Returns the exit code
+	int history_stats(int argc, char **argv);
+}
@@ -7,4 +7,8 @@ namespace pomocom
 	void interface_ansi_loop();
 	void interface_ncurses_loop();
 	void interface_wx_loop();
+	void interface_daemon_loop();
+
+	// Runs the pomo file through cycles cycles on a virtual clock
+	void interface_simulate_loop(long cycles);
 }
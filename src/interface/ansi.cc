@@ -2,74 +2,175 @@
  * ansi.cc contains functions for using the ANSI interface.
  */
 
-#include <chrono>	// For sleeping
-#include <cstdlib>	// For std::time_t and std::time()
-#include <iostream>	// For std::cout
-#include <thread>	// For sleeping
+#include <string>
+#include <string_view>
 
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../error.hh"
 #include "../state.hh"
 #include "../pomocom.hh"
-#include "base.hh"
+#include "../startup.hh"
+#include "all.hh"
+#include "frame.hh"
+#include "term.hh"
+#include "tick.hh"
 
 // Macros for using ANSI terminal escape codes
 
-// Clear the screen
-#define	AT_CLEAR	"\033[2J\033[0;0H"
+// Hide/show the cursor
+#define	AT_CUR_HIDE	"\033[?25l"
+#define	AT_CUR_SHOW	"\033[?25h"
 
-// Clear the entire line that the cursor is on
-#define	AT_CLEAR_LINE	"\r\033[K"
+namespace pomocom
+{
+	// Rows of the screen
+	enum AnsiRow{
+		AROW_HEADER,
+		AROW_SECTION,
+		AROW_TIME,
+	};
 
-// Clear from the cursor to the end of the line the cursor is on
-#define	AT_CLEAR_REST	"\033[K"
+	// Screen contents
+	// Only cells that changed since the last flush are sent to the terminal
+	static FrameBuffer frame;
 
-// Move the cursor up/down/left/right x times
-#define	AT_CUR_UP(x)	"\033[" #x "A"
-#define	AT_CUR_DOWN(x)	"\033[" #x "B"
-#define	AT_CUR_LEFT(x)	"\033[" #x "D"
-#define	AT_CUR_RIGHT(x)	"\033[" #x "C"
+	// Terminal attributes from before the interface started
+	static struct termios termios_old;
+
+	// True if termios_old holds attributes that need to be restored
+	static bool termios_changed = false;
+
+	static inline void interface_ansi_init();
+	static inline void interface_ansi_exit();
+
+	// TermView functions
+	static void print_upcoming_section(const SectionInfo &si);
+	static void print_section();
+	static void print_time_left(int mins, int secs, bool paused);
+	static void flush();
+	static void resize();
+	static int read_key();
 
-namespace pomocom
-{
 	// Runs the interface loop
-	// This is only exited by a forced shutdown of the program (ex. when SIGINT is sent on posix)
 	void interface_ansi_loop()
 	{
-		// Time points of current timing section
-		std::time_t time_start;
-		std::time_t time_current;
-		std::time_t time_end;
+		static const TermView view = {
+			.print_upcoming_section = print_upcoming_section,
+			.print_section = print_section,
+			.print_time_left = print_time_left,
+			.flush = flush,
+			.resize = resize,
+			.reload = nullptr,
+			.read_key = read_key,
+		};
 
-		for (;;)
+		interface_ansi_init();
+		startup_mark("ansi init");
+		try{ term_loop(view); }
+		catch (...)
 		{
-			// Reference to info on the current section
-			SectionInfo &si = state.section_info[state.current_section];
+			interface_ansi_exit();
+			throw;
+		}
+		interface_ansi_exit();
+	}
 
-			// Print the pomocom text
-			std::cout << AT_CLEAR;
-			std::cout << "pomocom: " << state.file_name << '\n';
-			
-			// Print the section name
-			std::cout << si.name << '\n';
+	static inline void interface_ansi_init()
+	{
+		// Read keys as soon as they are pressed without echoing them
+		// If stdin isn't a terminal, keys are read as they come in
+		if (tcgetattr(STDIN_FILENO, &termios_old) == 0)
+		{
+			struct termios t = termios_old;
+			t.c_lflag &= ~(ICANON | ECHO);
+			t.c_cc[VMIN] = 1;
+			t.c_cc[VTIME] = 0;
+			if (tcsetattr(STDIN_FILENO, TCSANOW, &t) == -1)
+			{
+				PERR("failed to set terminal attributes");
+				throw EXCEPT_GENERIC;
+			}
+			termios_changed = true;
+		}
 
-			// Start the timing section
-			time_start = std::time(nullptr);
-			time_end = time_start + si.secs;
+		// The frame buffer moves the cursor around to change single cells, so don't show it
+		frame.invalidate();
+		write(STDOUT_FILENO, AT_CUR_HIDE, sizeof(AT_CUR_HIDE) - 1);
+	}
 
-			while ((time_current = std::time(nullptr)) < time_end)
-			{
-				// Print the time remaining
-				std::time_t time_left = time_end - time_current;
-				int mins = time_left / 60;
-				int secs = time_left % 60;
-				std::cout << AT_CLEAR_LINE;
-				std::cout << mins << "m " << secs << "s";
-				if (state.settings.set_terminal_title_countdown)
-					base_set_terminal_title_countdown(mins, secs, si.name);
-				std::this_thread::sleep_for(std::chrono::seconds(state.settings.update_interval));
+	static inline void interface_ansi_exit()
+	{
+		if (termios_changed)
+		{
+			tcsetattr(STDIN_FILENO, TCSANOW, &termios_old);
+			termios_changed = false;
+		}
+		write(STDOUT_FILENO, AT_CUR_SHOW "\n", sizeof(AT_CUR_SHOW "\n") - 1);
+	}
 
-			}
+	// Print info about the upcoming section
+	static void print_upcoming_section(const SectionInfo &si)
+	{
+		frame.clear();
+		frame.put(AROW_HEADER, std::string("pomocom: ") + state.file_name);
+		frame.put(AROW_SECTION, std::string("next up: ") + state.sections.name(si) + " (" + std::to_string(si.secs / 60) + 'm' + std::to_string(si.secs % 60) + "s)");
+		frame.put(AROW_TIME, std::string("press ") + state.settings.key.section_begin + " to begin.");
+	}
+
+	// Clear the screen and print the header and current section name
+	static void print_section()
+	{
+		frame.clear();
+		frame.put(AROW_HEADER, std::string("pomocom: ") + state.file_name);
+		frame.put(AROW_SECTION, state.sections.name(state.sections[state.current_section]));
+	}
 
-			base_next_section();
+	// Print the time left in a section
+	static void print_time_left(int mins, int secs, bool paused)
+	{
+		// This runs on every tick, so format into a fixed buffer instead of allocating
+		constexpr std::string_view paused_str = " (paused)";
+		char time[TICK_TIME_LEN_MAX + paused_str.size()];
+		int len = tick_format_time(time, mins, secs);
+		if (paused)
+		{
+			paused_str.copy(time + len, paused_str.size());
+			len += paused_str.size();
 		}
+		frame.put(AROW_TIME, std::string_view(time, len));
+	}
+
+	// Make sure everything printed so far is shown
+	static void flush()
+	{
+		if (!frame.flush(STDOUT_FILENO))
+			PERR("failed to write to the terminal");
+	}
+
+	// Handle the terminal being resized
+	static void resize()
+	{
+		// The terminal may have moved text around, so redraw everything
+		frame.invalidate();
+	}
+
+	// Returns the next key pressed without blocking
+	static int read_key()
+	{
+		// Check if input is available so read() doesn't block
+		struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+		if (poll(&pfd, 1, 0) != 1)
+			return TERM_KEY_NONE;
+
+		unsigned char c;
+		ssize_t n = read(STDIN_FILENO, &c, 1);
+		if (n == 1)
+			return c;
+		if (n == 0 || !(pfd.revents & POLLIN))
+			return TERM_KEY_EOF;
+		return TERM_KEY_NONE;
 	}
 }
@@ -2,60 +2,88 @@
  * base.cc contains functions that handle base pomodoro functionality and are called in interface code.
  */
 
-#include <cstdlib>		// For std::system()
-#include <sstream>
+#include <cstring>	// For std::memcpy()
 #include <string>
 
-#include "../error.hh"
-#include "../pomocom.hh"	// For Section
+#include "../command.hh"
+#include "../history.hh"
+#include "../journal.hh"
 #include "../state.hh"
+#include "../status_page.hh"
 #include "../terminal_title.hh"
 #include "base.hh"
+#include "tick.hh"
 
 namespace pomocom
 {
+	// Max # of chars in a countdown terminal title, longer titles are cut off
+	constexpr std::size_t TITLE_LEN_MAX = 512;
+
 	// Used to switch sections in interface code
-	static void base_switch_section(Section new_section);
+	static void base_switch_section(std::size_t new_section);
 
 	// Handles switching to the next timing section after one finishes
 	void base_next_section()
 	{
-		if (state.current_section == SECTION_WORK)
-		{
-			// Break is starting
-			base_switch_section(
-				state.breaks_until_long == 0 ? SECTION_BREAK_LONG : SECTION_BREAK
-				);
-		}
-		else
-		{
-			// Break is ending
-			if (state.current_section == SECTION_BREAK)
-				--state.breaks_until_long;
-			else
-				state.breaks_until_long = state.settings.breaks_until_long_reset;
-			base_switch_section(SECTION_WORK);
-		}
+		history_record(state.sections[state.current_section].kind, state.current_section_secs, false);
+		base_switch_section(state.sections.next(state.current_section));
+	}
+
+	// Handles skipping the current section after secs_timed secs were spent in it
+	void base_skip_section(int secs_timed)
+	{
+		history_record(state.sections[state.current_section].kind, secs_timed, true);
+		base_switch_section(state.sections.next(state.current_section));
+	}
+
+	// Writes to the status page and journal that the current section is being timed and ends at end
+	void base_publish_running(std::chrono::steady_clock::time_point end)
+	{
+		const SectionInfo &si = state.sections[state.current_section];
+		status_page_write(si.kind, state.sections.name(si), false, 0, end);
+		journal_write_running(state.current_section, end);
+	}
+
+	// Writes to the status page and journal that the current section is paused or hasn't started yet and has secs_left secs left
+	void base_publish_paused(int secs_left)
+	{
+		const SectionInfo &si = state.sections[state.current_section];
+		status_page_write(si.kind, state.sections.name(si), true, secs_left, {});
+		journal_write_paused(state.current_section, secs_left);
 	}
 
 	// Sets the terminal title to a countdown timer
 	void base_set_terminal_title_countdown(int mins, int secs, std::string_view section_name)
 	{
-		std::stringstream title;
-		title << mins << "m " << secs << "s - pomocom - " << state.file_name << " - " << section_name;
-		set_terminal_title(title.view());
+		// This runs on every tick, so build the title in a fixed buffer instead of allocating
+		char title[TITLE_LEN_MAX];
+		std::size_t len = tick_format_time(title, mins, secs);
+		auto append = [&title, &len](std::string_view str)
+			{
+				std::size_t n = str.size() < TITLE_LEN_MAX - len ? str.size() : TITLE_LEN_MAX - len;
+				std::memcpy(title + len, str.data(), n);
+				len += n;
+			};
+		append(" - pomocom - ");
+		append(state.file_name);
+		append(" - ");
+		append(section_name);
+		set_terminal_title(std::string_view(title, len));
 	}
 
 	// Used to switch sections in interface code
-	static void base_switch_section(Section new_section)
+	static void base_switch_section(std::size_t new_section)
 	{
 		// Change section
 		state.current_section = new_section;
+		const SectionInfo &si = state.sections[new_section];
+		state.current_section_secs = si.secs;
+
+		// Start the section command without waiting for it to finish
+		// Its exit code is checked later in command_reap()
+		command_spawn(state.sections.cmd(si));
 
-		// Call section command
-		char *cmd = state.section_info[new_section].cmd;
-		int exit_code = std::system(cmd);
-		if (exit_code)
-			PERR("section command \"%s\" exited with nonzero exit code %d", cmd, exit_code);
+		// The section hasn't started being timed yet
+		base_publish_paused(si.secs);
 	}
 }
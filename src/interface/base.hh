@@ -2,15 +2,23 @@
  * base.hh contains functions that handle base pomodoro functionality and are called in interface code.
  */
 
+#include <chrono>
 #include <string>	// For std::string_view
 
-#include "../pomocom.hh"	// For Section
-
 namespace pomocom
 {
 	// Handles switching to the next timing section after one finishes
 	void base_next_section();
 
+	// Handles skipping the current section after secs_timed secs were spent in it
+	void base_skip_section(int secs_timed);
+
+	// Writes to the status page and journal that the current section is being timed and ends at end
+	void base_publish_running(std::chrono::steady_clock::time_point end);
+
+	// Writes to the status page and journal that the current section is paused or hasn't started yet and has secs_left secs left
+	void base_publish_paused(int secs_left);
+
 	// Sets the terminal title to a countdown timer
 	void base_set_terminal_title_countdown(int mins, int secs, std::string_view section_name);
 }
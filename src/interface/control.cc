@@ -0,0 +1,450 @@
+/*
+ * control.cc contains the control socket used to query and control a running pomocom.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>	// For std::getenv() and EXIT_*
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>	// For flock()
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../error.hh"
+#include "../pomo.hh"
+#include "../settings.hh"
+#include "../state.hh"
+#include "control.hh"
+
+namespace pomocom
+{
+	// Max # of bytes a client can send without ending the line
+	constexpr std::size_t CONTROL_LINE_MAX = 4096;
+
+	// Fills addr with the address of the control socket
+	// Returns false if the path is too long
+	static bool control_socket_addr(const std::string &path, struct sockaddr_un &addr);
+
+	// Writes all of *str to socket fd
+	// Returns false on error
+	static bool write_all(int fd, std::string_view str);
+
+	// Sends as much of out as non-blocking socket fd takes and removes it from out
+	// Returns false on error
+	static bool send_pending(int fd, std::string &out);
+
+	// Returns true if the process on the other end of socket fd is run by the same user
+	static bool control_peer_trusted(int fd);
+
+	// Opens and locks the lock file of the control socket at *path
+	// Returns the locked file descriptor, or -1 if the file can't be trusted
+	// Throws EXCEPT_GENERIC if another pomocom holds the lock
+	static int control_lock(const std::string &path);
+
+	// Returns the absolute path of the pomo file named *name without its .pomo extension, or an empty string if its directory doesn't exist
+	static std::string control_resolve_pomo(const char *name);
+
+	// Starts listening on the control socket and watches it with reactor
+	// If the socket can't be created, an error is printed and the server does nothing
+	// Throws EXCEPT_GENERIC if another pomocom is already listening, so two timers don't run at once
+	ControlServer::ControlServer(Reactor &reactor) :
+		m_reactor(reactor),
+		m_listen_fd(-1),
+		m_lock_fd(-1),
+		m_path(control_socket_path())
+	{
+		struct sockaddr_un addr;
+		if (!control_socket_addr(m_path, addr))
+		{
+			PERR("control socket path \"%s\" is too long", m_path.c_str());
+			return;
+		}
+
+		// Whoever holds the lock owns the socket file
+		m_lock_fd = control_lock(m_path);
+		if (m_lock_fd == -1)
+			return;
+
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd == -1)
+		{
+			PERR("failed to create control socket");
+			close(m_lock_fd);
+			m_lock_fd = -1;
+			return;
+		}
+
+		bool bound = bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+		if (!bound && errno == EADDRINUSE)
+		{
+			// The socket file is left over from a pomocom that didn't exit cleanly, since the lock would still be held otherwise, so replace it
+			unlink(m_path.c_str());
+			bound = bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+		}
+		if (!bound || listen(fd, 16) == -1 || !m_reactor.watch(fd))
+		{
+			PERR("failed to listen on control socket \"%s\"", m_path.c_str());
+			close(fd);
+			close(m_lock_fd);
+			m_lock_fd = -1;
+			return;
+		}
+
+		m_listen_fd = fd;
+	}
+
+	ControlServer::~ControlServer()
+	{
+		while (!m_clients.empty())
+			close_client(m_clients.begin()->first);
+
+		if (m_listen_fd != -1)
+		{
+			m_reactor.unwatch(m_listen_fd);
+			close(m_listen_fd);
+			unlink(m_path.c_str());
+		}
+
+		// The lock file is left in place, because removing it would let two pomocoms lock different files with the same path
+		if (m_lock_fd != -1)
+			close(m_lock_fd);
+	}
+
+	// Handles a REV_FD event for fd
+	// Sends queued responses, and calls handler for each complete request line once they have been sent
+	// Returns false if fd doesn't belong to the server
+	bool ControlServer::handle(int fd, const ControlHandler &handler)
+	{
+		if (fd == -1)
+			return false;
+
+		if (fd == m_listen_fd)
+		{
+			// Accept every pending connection
+			int client_fd;
+			while ((client_fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+			{
+				if (control_peer_trusted(client_fd) && m_reactor.watch(client_fd))
+					m_clients[client_fd];
+				else
+					close(client_fd);
+			}
+			return true;
+		}
+
+		auto it = m_clients.find(fd);
+		if (it == m_clients.end())
+			return false;
+		ControlClient &client = it->second;
+
+		// Don't read more requests until the responses to the earlier ones are sent
+		if (!client.output.empty())
+		{
+			if (!send_pending(fd, client.output))
+			{
+				close_client(fd);
+				return true;
+			}
+			if (!client.output.empty())
+				return true;
+			if (!m_reactor.watch_writable(fd, false))
+			{
+				close_client(fd);
+				return true;
+			}
+		}
+
+		char buf[512];
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n == -1 && (errno == EAGAIN || errno == EINTR))
+			return true;
+		if (n <= 0)
+		{
+			close_client(fd);
+			return true;
+		}
+		client.input.append(buf, n);
+
+		// Handle every complete line
+		std::string &input = client.input;
+		std::size_t line_start = 0;
+		for (std::size_t i; (i = input.find('\n', line_start)) != std::string::npos; line_start = i + 1)
+			handler(std::string_view(input).substr(line_start, i - line_start), client.output);
+		input.erase(0, line_start);
+
+		// Wait until the socket can take the rest of the responses
+		if (!send_pending(fd, client.output) || input.size() > CONTROL_LINE_MAX || (!client.output.empty() && !m_reactor.watch_writable(fd, true)))
+			close_client(fd);
+		return true;
+	}
+
+	// Stops watching and closes the connection to client fd
+	void ControlServer::close_client(int fd)
+	{
+		m_reactor.unwatch(fd);
+		close(fd);
+		m_clients.erase(fd);
+	}
+
+	// Returns the path of the control socket
+	std::string control_socket_path()
+	{
+		const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+		if (runtime_dir != nullptr && runtime_dir[0] != '\0')
+			return std::string(runtime_dir) + "/pomocom.sock";
+		return "/tmp/pomocom-" + std::to_string(getuid()) + ".sock";
+	}
+
+	// Connects to the control socket of a running pomocom
+	// Returns the connected file descriptor, or -1 if no pomocom is running
+	int control_connect()
+	{
+		struct sockaddr_un addr;
+		if (!control_socket_addr(control_socket_path(), addr))
+			return -1;
+
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd == -1)
+			return -1;
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+		{
+			close(fd);
+			return -1;
+		}
+		if (!control_peer_trusted(fd))
+		{
+			PERR("control socket \"%s\" is run by another user, ignoring it", control_socket_path().c_str());
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	// Sends *request over fd and reads the response line into response
+	// Returns false if the connection failed
+	bool control_request(int fd, std::string_view request, std::string &response)
+	{
+		std::string line(request);
+		line += '\n';
+		if (!write_all(fd, line))
+			return false;
+
+		response.clear();
+		for (;;)
+		{
+			char buf[512];
+			ssize_t n = read(fd, buf, sizeof(buf));
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			response.append(buf, n);
+
+			std::size_t end = response.find('\n');
+			if (end != std::string::npos)
+			{
+				response.resize(end);
+				return true;
+			}
+		}
+	}
+
+	// Runs "pomocom ctl": sends the arguments joined by spaces as one request and prints the response
+	// Returns the program exit code
+	int control_client(int argc, char **argv)
+	{
+		std::string request;
+		for (int i = 0; i < argc; ++i)
+		{
+			if (i > 0)
+				request += ' ';
+
+			// "start" can be given only a time of day, which isn't a pomo file
+			int start_time;
+			bool is_pomo = i == 1 && (std::strcmp(argv[0], "load") == 0 || std::strcmp(argv[0], "start") == 0);
+			if (is_pomo && std::strcmp(argv[0], "start") == 0 && pomo_parse_time_of_day(argv[i], start_time))
+				is_pomo = false;
+			if (is_pomo)
+			{
+				std::string path = control_resolve_pomo(argv[i]);
+				if (path.empty())
+				{
+					PERR("can't find the directory of pomo file \"%s\"", argv[i]);
+					return EXIT_FAILURE;
+				}
+				request += path;
+			}
+			else
+				request += argv[i];
+		}
+		if (request.empty())
+			request = "status";
+
+		int fd = control_connect();
+		if (fd == -1)
+		{
+			PERR("no running pomocom found at \"%s\"", control_socket_path().c_str());
+			return EXIT_FAILURE;
+		}
+
+		std::string response;
+		bool ok = control_request(fd, request, response);
+		close(fd);
+		if (!ok)
+		{
+			PERR("lost connection to running pomocom");
+			return EXIT_FAILURE;
+		}
+
+		std::cout << response << '\n';
+		return response.starts_with("ok") ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Shows the countdown of the running pomocom connected through fd until it exits or SIGINT is received
+	void control_attach(int fd)
+	{
+		std::cout << "pomocom: attached to running pomocom\n";
+
+		std::string response;
+		while (control_request(fd, "status", response))
+		{
+			// Response format: ok (id) (section kind) (paused) (secs left) (section name)
+			std::istringstream fields(response);
+			std::string ok, name;
+			int id, kind, paused, secs_left;
+			if (!(fields >> ok >> id >> kind >> paused >> secs_left) || ok != "ok")
+				break;
+			fields.get();
+			std::getline(fields, name);
+
+			std::cout << "\r\033[K" << name << ": " << secs_left / 60 << "m " << secs_left % 60 << 's';
+			if (paused)
+				std::cout << " (paused)";
+			std::cout << std::flush;
+
+			// Wait a second before asking again, and stop early if the running pomocom exits
+			struct pollfd pfd = {fd, POLLIN, 0};
+			if (poll(&pfd, 1, 1000) != 0)
+				break;
+		}
+		std::cout << '\n';
+	}
+
+	// Fills addr with the address of the control socket
+	// Returns false if the path is too long
+	static bool control_socket_addr(const std::string &path, struct sockaddr_un &addr)
+	{
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+			return false;
+		std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+
+	// Returns true if the process on the other end of socket fd is run by the same user
+	static bool control_peer_trusted(int fd)
+	{
+		struct ucred cred;
+		socklen_t len = sizeof(cred);
+		return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+	}
+
+	// Opens and locks the lock file of the control socket at *path
+	// Returns the locked file descriptor, or -1 if the file can't be trusted
+	// Throws EXCEPT_GENERIC if another pomocom holds the lock
+	static int control_lock(const std::string &path)
+	{
+		// The /tmp fallback is shared with other users, so don't follow links there and make sure the file is ours
+		std::string lock_path = path + ".lock";
+		int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+		struct stat st;
+		if (fd == -1 || fstat(fd, &st) == -1 || st.st_uid != getuid() || !S_ISREG(st.st_mode))
+		{
+			PERR("failed to open control socket lock file \"%s\"", lock_path.c_str());
+			if (fd != -1)
+				close(fd);
+			return -1;
+		}
+
+		if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+		{
+			PERR("pomocom is already running, use \"pomocom ctl\" to control it");
+			close(fd);
+			throw EXCEPT_GENERIC;
+		}
+		return fd;
+	}
+
+	// Returns the absolute path of the pomo file named *name without its .pomo extension, or an empty string if its directory doesn't exist
+	static std::string control_resolve_pomo(const char *name)
+	{
+		// Names without a directory are looked up in path.section, which needs the settings
+		settings_read(state.settings);
+		std::string path = pomo_path(name);
+
+		// Only resolve the directory, so a pomo file that is a link still gets its own name
+		std::size_t slash = path.rfind('/');
+		std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+		std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+		char *real_dir = realpath(dir.c_str(), nullptr);
+		if (real_dir == nullptr)
+			return "";
+
+		std::string resolved = real_dir;
+		std::free(real_dir);
+		resolved += '/';
+		resolved.append(file, 0, file.size() - std::strlen(".pomo"));
+		return resolved;
+	}
+
+	// Writes all of *str to socket fd
+	// Returns false on error
+	static bool write_all(int fd, std::string_view str)
+	{
+		while (!str.empty())
+		{
+			// MSG_NOSIGNAL prevents SIGPIPE from ending pomocom when the other side has disconnected
+			ssize_t n = send(fd, str.data(), str.size(), MSG_NOSIGNAL);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			str.remove_prefix(n);
+		}
+		return true;
+	}
+
+	// Sends as much of out as non-blocking socket fd takes and removes it from out
+	// Returns false on error
+	static bool send_pending(int fd, std::string &out)
+	{
+		std::size_t sent = 0;
+		while (sent < out.size())
+		{
+			// MSG_NOSIGNAL prevents SIGPIPE from ending pomocom when the other side has disconnected
+			ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					return false;
+				break;
+			}
+			sent += n;
+		}
+		out.erase(0, sent);
+		return true;
+	}
+}
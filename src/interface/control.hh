@@ -0,0 +1,101 @@
+/*
+ * control.hh contains the control socket used to query and control a running pomocom.
+ *
+ * A running terminal or daemon interface listens on a local AF_UNIX stream socket at $XDG_RUNTIME_DIR/pomocom.sock (or /tmp/pomocom-(uid).sock if $XDG_RUNTIME_DIR isn't set). Clients send one request per line and get one response line back for each request. Connections can stay open for more requests.
+ *
+ * Requests can be sent without waiting for the responses. Responses the socket can't take yet are queued for the client, and its requests aren't read until the queue has been sent, so a client that doesn't read its responses can't make pomocom block or grow the queue.
+ *
+ * The server holds an flock() on (socket path).lock while it listens, so a socket file is only replaced when the pomocom that made it is gone, and two pomocoms started at once can't both take it. Both sides check that the other end of a connection is run by the same user, since another user can create the /tmp fallback path first.
+ *
+ * Requests understood by the terminal interfaces:
+ * status		Responds with "ok 0 (section kind) (1 if paused, 0 otherwise) (secs left) (section name)"
+ *		The section kind is 0 for work, 1 for a break, and 2 for a long break
+ * pause
+ * resume
+ * skip
+ * load (pomo file)	Reads a pomo file and starts its work section
+ * quit
+ *
+ * The daemon interface understands the commands described in daemon.cc, which take a session id.
+ * Responses start with "ok" on success and "err" on failure.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "reactor.hh"
+
+namespace pomocom
+{
+	// Handles request *request and appends the response line to response
+	using ControlHandler = std::function<void(std::string_view request, std::string &response)>;
+
+	// Connection to a control client
+	struct ControlClient{
+		// Received input that isn't a complete request yet
+		std::string input;
+
+		// Responses that haven't been sent yet
+		std::string output;
+	};
+
+	// Listens on the control socket and handles requests from clients
+	struct ControlServer{
+	private:
+		Reactor &m_reactor;
+
+		// -1 if the server couldn't be started
+		int m_listen_fd;
+
+		// Lock file held while listening, or -1
+		int m_lock_fd;
+
+		// Path the socket is bound to
+		std::string m_path;
+
+		// Connected clients
+		// Key: client file descriptor
+		std::unordered_map<int, ControlClient> m_clients;
+
+		// Stops watching and closes the connection to client fd
+		void close_client(int fd);
+	public:
+		// Starts listening on the control socket and watches it with reactor
+		// If the socket can't be created, an error is printed and the server does nothing
+		// Throws EXCEPT_GENERIC if another pomocom is already listening, so two timers don't run at once
+		ControlServer(Reactor &reactor);
+		~ControlServer();
+
+		ControlServer(const ControlServer &) = delete;
+		ControlServer &operator=(const ControlServer &) = delete;
+
+		// Handles a REV_FD event for fd
+		// Sends queued responses, and calls handler for each complete request line once they have been sent
+		// Returns false if fd doesn't belong to the server
+		bool handle(int fd, const ControlHandler &handler);
+	};
+
+	// Returns the path of the control socket
+	std::string control_socket_path();
+
+	// Connects to the control socket of a running pomocom
+	// Returns the connected file descriptor, or -1 if no pomocom is running
+	int control_connect();
+
+	// Sends *request over fd and reads the response line into response
+	// Returns false if the connection failed
+	bool control_request(int fd, std::string_view request, std::string &response);
+
+	// Runs "pomocom ctl": sends the arguments joined by spaces as one request and prints the response
+	// The pomo file of a load or start request is sent as an absolute path, so the running pomocom doesn't look for it relative to its own working directory
+	// A start request given only a time of day is sent as it is
+	// Returns the program exit code
+	int control_client(int argc, char **argv);
+
+	// Shows the countdown of the running pomocom connected through fd until it exits or SIGINT is received
+	void control_attach(int fd);
+}
@@ -0,0 +1,425 @@
+/*
+ * daemon.cc contains the headless daemon interface.
+ *
+ * The daemon runs many independent sessions in one process. Each session has its own pomo file and current section. All sessions are timed by one Reactor, and section deadlines are kept in a TimingWheel (see timing_wheel.hh) with millisecond ticks, so starting, pausing, resuming, skipping, and stopping a session are O(1) and every section that ends on the same tick is handled in one batch. Pomo files are read once and shared by every session that uses them, so each session only costs the size of a Session object.
+ *
+ * The daemon is controlled by writing lines to its stdin or by sending them over the control socket (see control.hh). Responses are written to wherever the command came from, and section changes are written to stdout, one per line.
+ *
+ * Commands:
+ * start (optional pomo file) (optional HH:MM)	Starts a session and responds with "ok (session id)"
+ *		A time of day starts the session as if its first section had started then
+ *		A single argument that is a time of day is taken as the time, with the default pomo file
+ * pause (session id)		Pauses a session
+ * resume (session id)		Resumes a paused session
+ * skip (session id)		Skips to the next section of a session
+ * stop (session id)		Ends a session
+ * status (session id)		Responds with "ok (session id) (section kind) (1 if paused, 0 otherwise) (secs left) (section name)"
+ *
+ * Commands that fail respond with "err (message)", and other commands respond with "ok".
+ * When a section ends, "section (session id) (section kind) (section name)" is written.
+ * The section kind is 0 for work, 1 for a break, and 2 for a long break.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>	// For std::strtoul()
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "../command.hh"
+#include "../error.hh"
+#include "../jitter.hh"
+#include "../pomo.hh"
+#include "../startup.hh"
+#include "../pomocom.hh"
+#include "../state.hh"
+#include "../timing_wheel.hh"
+#include "all.hh"
+#include "base.hh"
+#include "control.hh"
+#include "reactor.hh"
+#include "tick.hh"
+
+namespace pomocom
+{
+	// Sections of a pomo file that are shared between sessions
+	struct Pomo{
+		SectionTable sections;
+	};
+
+	// A pomodoro timer run by the daemon
+	// The WheelTimer base schedules the end of the current section
+	struct Session : WheelTimer{
+		// Pomo file used by the session
+		// nullptr if the session has been stopped and its id can be reused
+		const Pomo *pomo;
+
+		// End of the current section
+		Clock::time_point time_end;
+
+		// Time left in the section when the session was paused
+		Clock::duration time_left_paused;
+
+		std::uint32_t id;
+
+		// Index of the current section in pomo->sections
+		std::uint32_t current_section;
+
+		bool paused;
+	};
+
+	// Data used by the daemon loop
+	struct Daemon{
+		Reactor reactor;
+
+		// Pomo files that have been read
+		// Key: name of the pomo file
+		std::unordered_map<std::string, std::unique_ptr<Pomo>> pomos;
+
+		// Sessions indexed by session id
+		// A deque is used so that sessions never move while they are in the wheel
+		std::deque<Session> sessions;
+
+		// Ids of stopped sessions that can be reused
+		std::vector<std::uint32_t> free_ids;
+
+		// Deadlines of running sessions in milliseconds since time_origin
+		TimingWheel wheel;
+
+		// Time point of wheel tick 0
+		Clock::time_point time_origin;
+
+		// Unprocessed input from stdin
+		std::string input;
+
+		// Output that hasn't been written to stdout yet
+		std::string output;
+
+		Daemon() : time_origin(Clock::now()) {}
+
+		// Starts a session using the pomo file named *name and appends the response to response
+		// If start_time isn't -1, the session starts with the section that is running now if the first section started start_time secs after midnight
+		void start(const char *name, int start_time, std::string &response);
+
+		// Handles one line of input and appends the response to response
+		void command(std::string_view line, std::string &response);
+
+		// Switches session s to its next section
+		void next_section(Session &s);
+
+		// Puts session s in the wheel at the tick of its deadline
+		void schedule(Session &s);
+
+		// Ends every section that is past its deadline and arms the reactor for the next deadline
+		void expire();
+
+		// Returns the session with the id in *arg or nullptr after appending an error to response if there isn't one
+		Session *get_session(std::string_view arg, std::string &response);
+
+		// Writes output to stdout
+		void flush();
+	};
+
+	// Runs the daemon until a terminating signal is received
+	void interface_daemon_loop()
+	{
+		Daemon d;
+		ControlServer server(d.reactor);
+		bool stdin_watched = d.reactor.watch(STDIN_FILENO);
+		ControlHandler handler = [&d](std::string_view line, std::string &response)
+			{
+				d.command(line, response);
+			};
+
+		// The daemon has no frame to draw, so it is started once it can take commands
+		startup_mark("daemon ready");
+		if (startup_profiling())
+			goto l_exit;
+
+		for (;;)
+		{
+			ReactorEvent ev = d.reactor.wait();
+			switch (ev.type)
+			{
+			case REV_TIMER:
+				d.expire();
+				break;
+			case REV_FD:
+				if (server.handle(ev.value, handler))
+				{
+					// Commands can change which deadline is first
+					d.expire();
+				}
+				else
+				{
+					char buf[4096];
+					ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+					if (n <= 0)
+					{
+						if (n == -1 && errno == EINTR)
+							break;
+
+						// Input was closed, keep running the sessions that exist
+						d.reactor.unwatch(STDIN_FILENO);
+						stdin_watched = false;
+						break;
+					}
+					d.input.append(buf, n);
+
+					// Handle every complete line
+					std::size_t line_start = 0;
+					for (std::size_t i; (i = d.input.find('\n', line_start)) != std::string::npos; line_start = i + 1)
+						d.command(std::string_view(d.input).substr(line_start, i - line_start), d.output);
+					d.input.erase(0, line_start);
+
+					// Commands can change which deadline is first
+					d.expire();
+				}
+				break;
+			case REV_SIGNAL:
+				if (ev.value == SIGCHLD)
+				{
+					command_notify_exit();
+					command_reap();
+				}
+				else if (ev.value != SIGWINCH)
+				{
+					// SIGTERM, SIGINT, or SIGHUP
+					goto l_exit;
+				}
+				break;
+			case REV_COMMAND:
+				if (ev.value == RCMD_QUIT)
+					goto l_exit;
+				break;
+			}
+			d.flush();
+		}
+	l_exit:
+		d.flush();
+		if (stdin_watched)
+			d.reactor.unwatch(STDIN_FILENO);
+	}
+
+	// Starts a session using the pomo file named *name and appends the response to response
+	// If start_time isn't -1, the session starts with the section that is running now if the first section started start_time secs after midnight
+	void Daemon::start(const char *name, int start_time, std::string &response)
+	{
+		// Read the pomo file if no session has used it yet
+		auto it = pomos.find(name);
+		if (it == pomos.end())
+		{
+			auto pomo = std::make_unique<Pomo>();
+			try{ pomo_read(name, pomo->sections); }
+			catch (Exception &e)
+			{
+				response += "err failed to read pomo file\n";
+				return;
+			}
+			it = pomos.emplace(name, std::move(pomo)).first;
+		}
+
+		// Get an id for the session
+		std::uint32_t id;
+		if (free_ids.empty())
+		{
+			id = sessions.size();
+			sessions.push_back({});
+		}
+		else
+		{
+			id = free_ids.back();
+			free_ids.pop_back();
+		}
+
+		Session &s = sessions[id];
+		s.id = id;
+		s.pomo = it->second.get();
+		s.paused = false;
+		if (start_time >= 0)
+		{
+			std::size_t index;
+			int secs_left;
+			pomo_seek_time_of_day(s.pomo->sections, start_time, index, secs_left);
+			s.current_section = index;
+			s.time_end = Clock::now() + std::chrono::seconds(secs_left);
+		}
+		else
+		{
+			s.current_section = 0;
+			s.time_end = Clock::now() + std::chrono::seconds(s.pomo->sections[0].secs);
+		}
+		schedule(s);
+
+		response += "ok " + std::to_string(id) + '\n';
+	}
+
+	// Handles one line of input and appends the response to response
+	void Daemon::command(std::string_view line, std::string &response)
+	{
+		// Split the line into the command name and its argument
+		std::size_t space = line.find(' ');
+		std::string_view name = line.substr(0, space);
+		std::string_view arg = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+		if (name.empty())
+			return;
+
+		if (name == "start")
+		{
+			// A time of day, alone or after the pomo file name, starts the session partway through it
+			int start_time = -1;
+			std::size_t time_space = arg.rfind(' ');
+			std::size_t time_start = time_space == std::string_view::npos ? 0 : time_space + 1;
+			if (pomo_parse_time_of_day(arg.substr(time_start), start_time))
+				arg = arg.substr(0, time_start == 0 ? 0 : time_space);
+
+			start(arg.empty() ? POMO_FILE_DEFAULT : std::string(arg).c_str(), start_time, response);
+			return;
+		}
+
+		if (name != "pause" && name != "resume" && name != "skip" && name != "stop" && name != "status")
+		{
+			response += "err unknown command\n";
+			return;
+		}
+
+		Session *s = get_session(arg, response);
+		if (s == nullptr)
+			return;
+
+		if (name == "pause")
+		{
+			if (!s->paused)
+			{
+				s->paused = true;
+				s->time_left_paused = s->time_end - Clock::now();
+				wheel.cancel(*s);
+			}
+		}
+		else if (name == "resume")
+		{
+			if (s->paused)
+			{
+				s->paused = false;
+				s->time_end = Clock::now() + s->time_left_paused;
+				schedule(*s);
+			}
+		}
+		else if (name == "skip")
+		{
+			s->time_end = Clock::now();
+			next_section(*s);
+			if (s->paused)
+				s->time_left_paused = s->time_end - Clock::now();
+			else
+				schedule(*s);
+		}
+		else if (name == "stop")
+		{
+			s->pomo = nullptr;
+			wheel.cancel(*s);
+			free_ids.push_back(s->id);
+		}
+		else if (name == "status")
+		{
+			auto time_current = Clock::now();
+			int secs_left = s->paused ?
+				tick_secs_left(time_current + s->time_left_paused, time_current) :
+				tick_secs_left(s->time_end, time_current);
+			const SectionInfo &si = s->pomo->sections[s->current_section];
+			response += "ok " + std::to_string(s->id) +
+				' ' + std::to_string(si.kind) +
+				' ' + (s->paused ? '1' : '0') +
+				' ' + std::to_string(secs_left) +
+				' ' + s->pomo->sections.name(si) + '\n';
+			return;
+		}
+
+		response += "ok\n";
+	}
+
+	// Switches session s to its next section
+	void Daemon::next_section(Session &s)
+	{
+		s.current_section = s.pomo->sections.next(s.current_section);
+		const SectionInfo &si = s.pomo->sections[s.current_section];
+
+		// The next section starts exactly when the previous one ended so that sessions don't drift
+		s.time_end += std::chrono::seconds(si.secs);
+
+		if (state.settings.daemon.run_section_commands)
+			command_spawn(s.pomo->sections.cmd(si));
+
+		output += "section " + std::to_string(s.id) + ' ' + std::to_string(si.kind) + ' ' + s.pomo->sections.name(si) + '\n';
+	}
+
+	// Puts session s in the wheel at the tick of its deadline
+	void Daemon::schedule(Session &s)
+	{
+		// Round up so that the session's tick is never before time_end
+		auto ticks = std::chrono::ceil<std::chrono::milliseconds>(s.time_end - time_origin).count();
+		wheel.insert(s, ticks > 0 ? ticks : 0);
+	}
+
+	// Ends every section that is past its deadline and arms the reactor for the next deadline
+	void Daemon::expire()
+	{
+		auto time_current = Clock::now();
+		auto ticks = std::chrono::floor<std::chrono::milliseconds>(time_current - time_origin).count();
+		wheel.advance(ticks, [this, time_current](WheelTimer &t)
+			{
+				Session &s = static_cast<Session &>(t);
+				jitter_record(JITTER_SECTION_END, s.time_end, time_current);
+				next_section(s);
+				schedule(s);
+			});
+
+		std::uint64_t next = wheel.next_expiry();
+		if (next == TimingWheel::NEVER)
+			reactor.disarm();
+		else
+			reactor.arm(time_origin + std::chrono::milliseconds(next));
+	}
+
+	// Returns the session with the id in *arg or nullptr after appending an error to response if there isn't one
+	Session *Daemon::get_session(std::string_view arg, std::string &response)
+	{
+		std::string id_str(arg);
+		char *end;
+		unsigned long id = std::strtoul(id_str.c_str(), &end, 10);
+		if (id_str.empty() || *end != '\0' || id >= sessions.size() || sessions[id].pomo == nullptr)
+		{
+			response += "err no session with id \"" + id_str + "\"\n";
+			return nullptr;
+		}
+		return &sessions[id];
+	}
+
+	// Writes output to stdout
+	void Daemon::flush()
+	{
+		std::size_t written = 0;
+		while (written < output.size())
+		{
+			ssize_t n = write(STDOUT_FILENO, output.data() + written, output.size() - written);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				PERR("failed to write daemon output");
+				break;
+			}
+			written += n;
+		}
+		output.clear();
+	}
+}
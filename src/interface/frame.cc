@@ -0,0 +1,198 @@
+/*
+ * frame.cc contains a frame buffer that draws to an ANSI terminal by only sending what changed.
+ */
+
+#include <cerrno>
+#include <charconv>	// For std::to_chars()
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "frame.hh"
+
+namespace pomocom
+{
+	// Returns the # of bytes in the UTF-8 character starting with byte lead
+	static int utf8_length(unsigned char lead);
+
+	// Appends the decimal digits of n to *out without allocating a temporary string
+	static void append_number(std::string &out, int n);
+
+	FrameBuffer::FrameBuffer() :
+		m_cursor_row(0),
+		m_cursor_col(0),
+		m_invalid(true)
+	{
+	}
+
+	// Empties the frame being built
+	void FrameBuffer::clear()
+	{
+		for (FrameRow &row : m_back)
+			row.clear();
+	}
+
+	// Replaces row # row of the frame being built with *text
+	void FrameBuffer::put(int row, std::string_view text)
+	{
+		if (row >= (int) m_back.size())
+			m_back.resize(row + 1);
+		FrameRow &cells = m_back[row];
+		cells.clear();
+
+		// Split the text into UTF-8 characters
+		for (std::size_t i = 0; i < text.size();)
+		{
+			int len = utf8_length(text[i]);
+			FrameCell c = 0;
+			for (int b = 0; b < len && i < text.size(); ++b, ++i)
+				c |= FrameCell((unsigned char) text[i]) << (b * 8);
+			cells.push_back(c);
+		}
+	}
+
+	// Makes the next render clear the screen and redraw everything
+	void FrameBuffer::invalidate()
+	{
+		m_invalid = true;
+	}
+
+	// Produces the output that turns the screen into the frame being built
+	// The frame being built becomes the frame on the screen, and is kept so that it can be changed with put()
+	void FrameBuffer::render()
+	{
+		if (m_invalid)
+		{
+			m_out += "\033[2J\033[H";
+			m_cursor_row = m_cursor_col = 0;
+			m_front.clear();
+			m_invalid = false;
+		}
+
+		static const FrameRow empty_row;
+		std::size_t rows = m_front.size() > m_back.size() ? m_front.size() : m_back.size();
+		for (std::size_t r = 0; r < rows; ++r)
+		{
+			const FrameRow &old_row = r < m_front.size() ? m_front[r] : empty_row;
+			const FrameRow &new_row = r < m_back.size() ? m_back[r] : empty_row;
+
+			// Find the first cell that changed
+			std::size_t first = 0;
+			while (first < old_row.size() && first < new_row.size() && old_row[first] == new_row[first])
+				++first;
+			if (first == old_row.size() && first == new_row.size())
+				continue;
+
+			// If the row length is the same, cells after the last changed cell don't need to be sent
+			std::size_t end = new_row.size();
+			if (new_row.size() == old_row.size())
+			{
+				while (end > first && old_row[end - 1] == new_row[end - 1])
+					--end;
+			}
+
+			move_cursor(r, first);
+			for (std::size_t i = first; i < end; ++i)
+				put_cell(new_row[i]);
+			m_cursor_col = end;
+
+			// Erase cells left over from a longer row
+			if (new_row.size() < old_row.size())
+				m_out += "\033[K";
+		}
+
+		m_front = m_back;
+	}
+
+	// Renders and writes the output to fd with one write(2)
+	// Returns false on error
+	bool FrameBuffer::flush(int fd)
+	{
+		render();
+
+		std::string_view out = m_out;
+		while (!out.empty())
+		{
+			ssize_t n = write(fd, out.data(), out.size());
+			if (n == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				m_out.clear();
+				return false;
+			}
+			out.remove_prefix(n);
+		}
+		m_out.clear();
+		return true;
+	}
+
+	// Appends the shortest escape sequence that moves the cursor to row, col
+	void FrameBuffer::move_cursor(int row, int col)
+	{
+		if (row == m_cursor_row && col == m_cursor_col)
+			return;
+
+		if (row == m_cursor_row)
+		{
+			// Relative moves are shorter than absolute moves on the same row
+			int n = col - m_cursor_col;
+			if (col == 0)
+				m_out += '\r';
+			else if (n == 1)
+				m_out += "\033[C";
+			else if (n == -1)
+				m_out += "\033[D";
+			else
+			{
+				m_out += "\033[";
+				append_number(m_out, n > 0 ? n : -n);
+				m_out += n > 0 ? 'C' : 'D';
+			}
+		}
+		else if (col == 0 && row == 0)
+			m_out += "\033[H";
+		else
+		{
+			m_out += "\033[";
+			append_number(m_out, row + 1);
+			m_out += ';';
+			append_number(m_out, col + 1);
+			m_out += 'H';
+		}
+
+		m_cursor_row = row;
+		m_cursor_col = col;
+	}
+
+	// Appends the bytes of cell c
+	void FrameBuffer::put_cell(FrameCell c)
+	{
+		do
+		{
+			m_out += (char) (c & 0xff);
+			c >>= 8;
+		} while (c != 0);
+	}
+
+	// Returns the # of bytes in the UTF-8 character starting with byte lead
+	static int utf8_length(unsigned char lead)
+	{
+		if (lead < 0xc0)
+			return 1;
+		if (lead < 0xe0)
+			return 2;
+		if (lead < 0xf0)
+			return 3;
+		return 4;
+	}
+
+	// Appends the decimal digits of n to *out without allocating a temporary string
+	static void append_number(std::string &out, int n)
+	{
+		char digits[16];
+		auto result = std::to_chars(digits, digits + sizeof(digits), n);
+		out.append(digits, result.ptr);
+	}
+}
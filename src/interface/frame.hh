@@ -0,0 +1,67 @@
+/*
+ * frame.hh contains a frame buffer that draws to an ANSI terminal by only sending what changed.
+ *
+ * A frame is a list of rows, and each row is a list of cells holding one UTF-8 character each. Interface code builds the next frame with clear() and put(), then render() compares it with the frame that is on the screen and produces the cursor movements and characters needed to turn one into the other. flush() sends that output with a single write(2), so a tick where one digit changes costs a few bytes instead of a whole line.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pomocom
+{
+	// One UTF-8 character with its bytes packed from the lowest byte up
+	using FrameCell = std::uint32_t;
+
+	using FrameRow = std::vector<FrameCell>;
+
+	struct FrameBuffer{
+	private:
+		// Frame that is on the screen
+		std::vector<FrameRow> m_front;
+
+		// Frame being built
+		std::vector<FrameRow> m_back;
+
+		// Output produced by render() that hasn't been written yet
+		std::string m_out;
+
+		// Position of the terminal cursor after the last render
+		int m_cursor_row;
+		int m_cursor_col;
+
+		// True if the screen contents are unknown and the next render must redraw everything
+		bool m_invalid;
+
+		// Appends the shortest escape sequence that moves the cursor to row, col
+		void move_cursor(int row, int col);
+
+		// Appends the bytes of cell c
+		void put_cell(FrameCell c);
+	public:
+		FrameBuffer();
+
+		// Empties the frame being built
+		void clear();
+
+		// Replaces row # row of the frame being built with *text
+		void put(int row, std::string_view text);
+
+		// Makes the next render clear the screen and redraw everything
+		void invalidate();
+
+		// Produces the output that turns the screen into the frame being built
+		// The frame being built becomes the frame on the screen, and is kept so that it can be changed with put()
+		void render();
+
+		// Renders and writes the output to fd with one write(2)
+		// Returns false on error
+		bool flush(int fd);
+
+		// Returns the output of the last render that hasn't been written yet
+		std::string_view output() const { return m_out; }
+	};
+}
@@ -0,0 +1,64 @@
+/*
+ * module.cc contains functions for loading interfaces that are built as modules.
+ */
+
+#include <string>
+
+#include <dlfcn.h>
+#include <unistd.h>	// For readlink()
+
+#include "../error.hh"
+#include "module.hh"
+
+#ifndef POMOCOM_MODULE_DIR
+#define POMOCOM_MODULE_DIR "/usr/local/lib/pomocom"
+#endif
+
+namespace pomocom
+{
+	// Returns the directory holding the pomocom binary, or an empty string if it can't be found
+	static std::string module_exe_dir();
+
+	// Loads the module of the interface named *name and runs its loop
+	// Throws EXCEPT_GENERIC if the module can't be loaded
+	void module_loop(const char *name)
+	{
+		std::string file_name = std::string("pomocom-") + name + ".so";
+
+		// RTLD_NOW reports missing libraries here instead of partway through running the interface
+		void *handle = nullptr;
+		std::string exe_dir = module_exe_dir();
+		if (!exe_dir.empty())
+			handle = dlopen((exe_dir + file_name).c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle == nullptr)
+			handle = dlopen((POMOCOM_MODULE_DIR "/" + file_name).c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle == nullptr)
+		{
+			PERR("failed to load the %s interface module: %s", name, dlerror());
+			throw EXCEPT_GENERIC;
+		}
+
+		auto loop = reinterpret_cast<void (*)()>(dlsym(handle, MODULE_LOOP_SYMBOL));
+		if (loop == nullptr)
+		{
+			PERR("\"%s\" isn't a pomocom interface module", file_name.c_str());
+			dlclose(handle);
+			throw EXCEPT_GENERIC;
+		}
+
+		// The module is never unloaded, because its libraries may have registered exit handlers
+		loop();
+	}
+
+	// Returns the directory holding the pomocom binary, or an empty string if it can't be found
+	static std::string module_exe_dir()
+	{
+		char path[4096];
+		ssize_t len = readlink("/proc/self/exe", path, sizeof(path));
+		if (len <= 0 || len == sizeof(path))
+			return "";
+
+		std::string dir(path, len);
+		return dir.substr(0, dir.rfind('/') + 1);
+	}
+}
@@ -0,0 +1,19 @@
+/*
+ * module.hh contains functions for loading interfaces that are built as modules.
+ *
+ * Depending on config.mk, the ncurses and wxWidgets interfaces are linked into pomocom, built as shared libraries named pomocom-(interface).so, or left out. A module is only loaded with dlopen() when the interface setting selects it, so pomocom doesn't load ncurses, wxWidgets, or GTK when it runs another interface. Modules are looked for next to the pomocom binary first, so a pomocom built in the project directory runs without being installed, and then in MODULE_DIR from config.mk.
+ *
+ * Each module defines pomocom_module_loop(), which runs its interface loop. Modules use the functions and global state of pomocom itself, which is linked with -rdynamic so that they can be found.
+ */
+
+#pragma once
+
+namespace pomocom
+{
+	// Loads the module of the interface named *name and runs its loop
+	// Throws EXCEPT_GENERIC if the module can't be loaded
+	void module_loop(const char *name);
+}
+
+// Name of the function that runs the interface loop of a module
+#define MODULE_LOOP_SYMBOL "pomocom_module_loop"
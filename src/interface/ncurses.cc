@@ -2,17 +2,16 @@
  * ncurses.cc contains functions for using the ncurses interface.
  */
 
-#include <chrono>		// For std::chrono::high_resolution_clock and more
-
 #include <ncurses.h>
 
 #include "../error.hh"
 #include "../pomocom.hh"
 #include "../settings.hh"
+#include "../startup.hh"
 #include "../state.hh"
-#include "base.hh"
-
-namespace chrono = std::chrono;
+#include "all.hh"
+#include "term.hh"
+#include "tick.hh"
 
 namespace pomocom
 {
@@ -24,23 +23,35 @@ namespace pomocom
 		CP_TIME,
 	};
 
+	// Color settings are passed to init_pair() as they are
+	static_assert(SETTING_COLOR_DEFAULT == -1 && SETTING_COLOR_BLACK == COLOR_BLACK && SETTING_COLOR_WHITE == COLOR_WHITE, "SettingColor must match the curses color numbers");
+
 	static inline void interface_ncurses_init();
 	static inline void interface_ncurses_exit();
 
 	// Print info about the upcoming section
-	static void print_upcoming_section(SectionInfo &si);
+	static void print_upcoming_section(const SectionInfo &si);
 
 	// Print the first line of text, which contains "pomocom:"
 	static void print_pomocom();
 
-	// Print the timing section name
+	// Clear the screen and print the header and current section name
 	static void print_section();
 
 	// Print the time left in a section
-	static void print_time_left(int mins, int secs);
+	static void print_time_left(int mins, int secs, bool paused);
+
+	// Make sure everything printed so far is shown
+	static void flush();
+
+	// Handle the terminal being resized
+	static void resize();
+
+	// Apply reloaded color settings
+	static void reload();
 
-	// Re-print the screen when KEY_RESIZE is detected during a timing section
-	static void reprint_timing_screen(int mins, int secs);
+	// Returns the next key pressed without blocking
+	static int read_key();
 
 	// Using attron(), activate the color pair for the section name text depending on the type of current section
 	static inline void activate_section_color();
@@ -50,160 +61,24 @@ namespace pomocom
 
 	void interface_ncurses_loop()
 	{
-		interface_ncurses_init();
-
-		// Alias for clock type
-		using Clock = chrono::high_resolution_clock;
-
-		// Alias for key settings
-		auto &key = state.settings.key;
-
-		// Store update interval in milliseconds
-		chrono::milliseconds update_interval(1000 * state.settings.update_interval);
-
-		// Start and end time points of timing section
-		chrono::time_point<Clock> time_start, time_current, time_end;
+		static const TermView view = {
+			.print_upcoming_section = print_upcoming_section,
+			.print_section = print_section,
+			.print_time_left = print_time_left,
+			.flush = flush,
+			.resize = resize,
+			.reload = reload,
+			.read_key = read_key,
+		};
 
-		// Repeatedly move through timing sections
-		for (;;)
+		interface_ncurses_init();
+		startup_mark("ncurses init");
+		try{ term_loop(view); }
+		catch (...)
 		{
-			// Reference to info on the current section
-			SectionInfo &si = state.section_info[state.current_section];
-
-			// Pause before starting the section
-			if (state.settings.pause_before_section_start)
-			{
-				print_upcoming_section(si);
-
-				// Make getch() wait for input before returning
-				timeout(-1);
-
-				// Wait until the section begin key is pressed or the user quits
-				for (;;)
-				{
-					int c = getch();
-					if (c == key.section_begin)
-						break;
-					if (c == key.section_skip)
-						goto l_section_end;
-					if (c == key.quit)
-						goto l_exit;
-					if (c == KEY_RESIZE)
-					{
-						// Prevent KEY_RESIZE from being read infinitely
-						flushinp();
-						print_upcoming_section(si);
-					}
-				}
-			}
-
-			clear();
-			print_pomocom();
-			print_section();
-
-			// Start the timing section
-			time_start = Clock::now();
-			time_end = time_start + chrono::seconds(si.secs);
-
-			// Repeatedly update the screen and check for input until section time is over
-			while ((time_current = Clock::now()) < time_end)
-			{
-				// Print the time left in the section
-				chrono::seconds time_left = chrono::ceil<chrono::seconds>(time_end - time_current);
-				int mins = time_left.count() / 60;
-				int secs = time_left.count() % 60;
-
-				print_time_left(mins, secs);
-				if (state.settings.set_terminal_title_countdown)
-					base_set_terminal_title_countdown(mins, secs, si.name);
-				refresh();
-
-				// Get user input
-				auto time_input_start = Clock::now();
-
-				// Expect to wait update_interval milliseconds for getch() to return
-				timeout(update_interval.count());
-
-			l_get_user_input:
-				int c = getch();
-				if (c == key.pause)
-				{
-					// Pause
-
-					// Print pause text
-					addstr(" (paused)");
-					refresh();
-
-					auto time_pause_start = Clock::now();
-
-					// Make getch() wait for input before returning
-					timeout(-1);
-
-					// Wait until pause is pressed again to trigger an unpause or the user quits
-					for (;;)
-					{
-						c = getch();
-						if (c == key.pause)
-							break;
-						if (c == key.quit)
-							goto l_exit;
-					}
-					
-					// Unpause
-					
-					// Extend time_end to include the time spent paused
-					time_end += Clock::now() - time_pause_start;
-
-					// Go back to updating the screen
-					continue;
-				}
-				else if (c == key.section_skip)
-				{
-					// Skip to next section by exiting the loop
-					break;
-				}
-				else if (c == key.quit)
-				{
-					// Quit
-					goto l_exit;
-				}
-				else if (c == ERR)
-				{
-					// If getch() returns ERR, the user did not input anything, so we don't need to wait any longer until the time remaining can be reprinted
-					continue;
-				}
-				else if (c == KEY_RESIZE)
-				{
-					reprint_timing_screen(mins, secs);
-
-					// Prevent KEY_RESIZE from being read infinitely
-					flushinp();
-				}
-
-				// If code execution reaches here, either the user has input an unrecognized key or performed an action that doesn't cause a continue, break, or goto.
-				// In both such cases, getch() has not returned ERR, so the time until the next screen update has not yet passed
-
-				// Recalculate the time until the next screen update
-				chrono::milliseconds time_until_screen_update = update_interval - chrono::duration_cast<chrono::milliseconds>(Clock::now() - time_input_start);
-
-				if (time_until_screen_update.count() <= 0)
-				{
-					// A screen update should happen now
-					continue;
-				}
-				else
-				{
-					// Reset timeout to reflect the change to the time until the next screen update
-					timeout(time_until_screen_update.count());
-
-					// Try to get more user input before the next screen update
-					goto l_get_user_input;
-				}
-			}
-		l_section_end:
-			base_next_section();
+			interface_ncurses_exit();
+			throw;
 		}
-	l_exit:
 		interface_ncurses_exit();
 	}
 
@@ -217,7 +92,8 @@ namespace pomocom
 		}
 
 		// Config input
-		if (cbreak() == ERR)
+		// getch() never blocks because term_loop() only reads keys after stdin is readable
+		if (cbreak() == ERR || nodelay(stdscr, TRUE) == ERR)
 		{
 			PERR("ncurses cbreak() call failed");
 			throw EXCEPT_GENERIC;
@@ -257,7 +133,7 @@ namespace pomocom
 	}
 
 	// Print info about the upcoming section
-	static void print_upcoming_section(SectionInfo &si)
+	static void print_upcoming_section(const SectionInfo &si)
 	{
 		clear();
 		print_pomocom();
@@ -265,23 +141,11 @@ namespace pomocom
 		// Print the upcoming section name and duration
 		move(1, 0);
 		activate_section_color();
-		printw("next up: %s (%dm%ds)\n", si.name, si.secs / 60, si.secs % 60);
+		printw("next up: %s (%dm%ds)\n", state.sections.name(si), si.secs / 60, si.secs % 60);
 
 		// Print section begin key
 		attron(COLOR_PAIR(CP_TIME));
 		printw("press %c to begin.", state.settings.key.section_begin);
-
-		refresh();
-	}
-
-	// Re-print the screen when KEY_RESIZE is detected during a timing section
-	static void reprint_timing_screen(int mins, int secs)
-	{
-		clear();
-		print_pomocom();
-		print_section();
-		print_time_left(mins, secs);
-		refresh();
 	}
 
 	// Print the first line of text, which contains "pomocom:"
@@ -292,30 +156,69 @@ namespace pomocom
 		printw("pomocom: %s", state.file_name);
 	}
 
-	// Print the timing section name
+	// Clear the screen and print the header and current section name
 	static void print_section()
 	{
+		clear();
+		print_pomocom();
 		move(1, 0);
 		activate_section_color();
-		printw("%s", state.section_info[state.current_section].name);
+		printw("%s", state.sections.name(state.sections[state.current_section]));
 	}
 
 	// Print the time left in a section
-	static void print_time_left(int mins, int secs)
+	static void print_time_left(int mins, int secs, bool paused)
 	{
 		move(2, 0);
 
 		// Clear the previous time left on the screen
 		clrtoeol();
 
+		// This runs on every tick, so skip printw()'s format parsing and write the digits directly
+		char time[TICK_TIME_LEN_MAX];
+		int len = tick_format_time(time, mins, secs);
 		attron(COLOR_PAIR(CP_TIME));
-		printw("%dm %ds", mins, secs);
+		addnstr(time, len);
+		if (paused)
+			addstr(" (paused)");
+	}
+
+	// Make sure everything printed so far is shown
+	static void flush()
+	{
+		refresh();
+	}
+
+	// Handle the terminal being resized
+	static void resize()
+	{
+		// SIGWINCH is received by the reactor instead of ncurses, so make ncurses read the new terminal size
+		endwin();
+		refresh();
+	}
+
+	// Apply reloaded color settings
+	static void reload()
+	{
+		// A color the terminal doesn't support leaves the pair as it was instead of quitting
+		auto &color = state.settings.ncurses.color;
+		init_pair(CP_POMOCOM,		color.pomocom.fg,	color.pomocom.bg);
+		init_pair(CP_SECTION_WORK,	color.section_work.fg,	color.section_work.bg);
+		init_pair(CP_SECTION_BREAK,	color.section_break.fg,	color.section_break.bg);
+		init_pair(CP_TIME,		color.time.fg,		color.time.bg);
+	}
+
+	// Returns the next key pressed without blocking
+	static int read_key()
+	{
+		int c = getch();
+		return c == ERR ? TERM_KEY_NONE : c;
 	}
 
 	// Using attron(), activate the color pair for the section name text depending on the type of current section
 	static inline void activate_section_color()
 	{
-		attron(COLOR_PAIR(state.current_section == SECTION_WORK ? CP_SECTION_WORK : CP_SECTION_BREAK));
+		attron(COLOR_PAIR(state.sections[state.current_section].kind == SECTION_WORK ? CP_SECTION_WORK : CP_SECTION_BREAK));
 	}
 
 	// Calls init_pair() and throws an exception on error
@@ -328,3 +231,11 @@ namespace pomocom
 		}
 	}
 }
+
+#ifdef POMOCOM_MODULE
+// Runs the interface loop when this interface is built as a module (see module.hh)
+extern "C" void pomocom_module_loop()
+{
+	pomocom::interface_ncurses_loop();
+}
+#endif
@@ -0,0 +1,227 @@
+/*
+ * reactor.cc contains the event reactor that drives the terminal interfaces.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "../error.hh"
+#include "../jitter.hh"
+#include "reactor.hh"
+
+namespace chrono = std::chrono;
+
+namespace pomocom
+{
+	// Adds fd to the epoll instance epoll_fd and throws an exception on error
+	static void try_epoll_add(int epoll_fd, int fd);
+
+	Reactor::Reactor() :
+		m_events_len(0),
+		m_events_index(0)
+	{
+		// Block the signals handled by the reactor so they are only received through the signalfd
+		sigset_t sigmask;
+		sigemptyset(&sigmask);
+		sigaddset(&sigmask, SIGWINCH);
+		sigaddset(&sigmask, SIGCHLD);
+		sigaddset(&sigmask, SIGTERM);
+		sigaddset(&sigmask, SIGINT);
+		sigaddset(&sigmask, SIGHUP);
+		if (sigprocmask(SIG_BLOCK, &sigmask, &m_old_sigmask) == -1)
+		{
+			PERR("failed to block reactor signals");
+			throw EXCEPT_GENERIC;
+		}
+
+		m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		m_signal_fd = signalfd(-1, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+		if (pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC) == -1)
+			m_pipe[0] = m_pipe[1] = -1;
+		if (m_epoll_fd == -1 || m_timer_fd == -1 || m_signal_fd == -1 || m_pipe[0] == -1)
+		{
+			PERR("failed to create reactor file descriptors");
+			close_fds();
+			throw EXCEPT_GENERIC;
+		}
+
+		try
+		{
+			try_epoll_add(m_epoll_fd, m_timer_fd);
+			try_epoll_add(m_epoll_fd, m_signal_fd);
+			try_epoll_add(m_epoll_fd, m_pipe[0]);
+		}
+		catch (...)
+		{
+			close_fds();
+			throw;
+		}
+	}
+
+	Reactor::~Reactor()
+	{
+		close_fds();
+	}
+
+	// Closes all file descriptors and restores the signal mask
+	void Reactor::close_fds()
+	{
+		for (int fd : {m_epoll_fd, m_timer_fd, m_signal_fd, m_pipe[0], m_pipe[1]})
+			if (fd != -1)
+				close(fd);
+
+		sigprocmask(SIG_SETMASK, &m_old_sigmask, nullptr);
+	}
+
+	// Makes wait() return a REV_TIMER event once time point t is reached
+	void Reactor::arm(Clock::time_point t)
+	{
+		m_deadline = t;
+
+		// On a virtual clock the timer fires right away, and wait() moves the clock to the deadline
+		auto since_epoch = clock_virtual ? 0 : chrono::duration_cast<chrono::nanoseconds>(t.time_since_epoch()).count();
+
+		// A zero it_value disarms the timer, so deadlines at the epoch are moved forward by 1ns
+		if (since_epoch <= 0)
+			since_epoch = 1;
+
+		struct itimerspec its{};
+		its.it_value.tv_sec = since_epoch / 1000000000;
+		its.it_value.tv_nsec = since_epoch % 1000000000;
+		if (timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) == -1)
+			PERR("failed to arm reactor timer");
+	}
+
+	// Cancels the deadline set with arm()
+	void Reactor::disarm()
+	{
+		struct itimerspec its{};
+		timerfd_settime(m_timer_fd, 0, &its, nullptr);
+	}
+
+	// Starts or stops watching fd for readability
+	// watch() returns false if fd can't be watched (ex. when it is a regular file)
+	bool Reactor::watch(int fd)
+	{
+		struct epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+	}
+	void Reactor::unwatch(int fd)
+	{
+		epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+		// Drop events for fd that were already fetched
+		for (int i = m_events_index; i < m_events_len; ++i)
+			if (m_events[i] == fd)
+				m_events[i] = -1;
+	}
+
+	// Switches watched fd between waiting for writability and readability
+	// Returns false on error
+	bool Reactor::watch_writable(int fd, bool writable)
+	{
+		struct epoll_event ev{};
+		ev.events = writable ? EPOLLOUT : EPOLLIN;
+		ev.data.fd = fd;
+		return epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+	}
+
+	// Sends cmd to the reactor
+	// This is safe to call from signal handlers and other threads
+	void Reactor::post(ReactorCommand cmd)
+	{
+		char c = cmd;
+		int saved_errno = errno;
+		if (write(m_pipe[1], &c, 1) != 1)
+		{
+			// The pipe is full, so the command is dropped
+		}
+		errno = saved_errno;
+	}
+
+	// Waits for the next event
+	ReactorEvent Reactor::wait()
+	{
+		for (;;)
+		{
+			// Fetch more events from the kernel once all of the previous ones have been handled
+			if (m_events_index == m_events_len)
+			{
+				struct epoll_event events[EVENTS_MAX];
+				int n = epoll_wait(m_epoll_fd, events, EVENTS_MAX, -1);
+				if (n == -1)
+				{
+					if (errno == EINTR)
+						continue;
+					PERR("epoll_wait() failed");
+					throw EXCEPT_GENERIC;
+				}
+				for (int i = 0; i < n; ++i)
+					m_events[i] = events[i].data.fd;
+				m_events_len = n;
+				m_events_index = 0;
+			}
+
+			int fd = m_events[m_events_index++];
+
+			if (fd == m_timer_fd)
+			{
+				// Reading clears the timerfd's readiness, and fails with EAGAIN if the timer was re-armed after the event was fetched
+				std::uint64_t expirations;
+				if (read(m_timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+				{
+					if (clock_virtual)
+						clock_set_virtual(m_deadline);
+					jitter_record(JITTER_WAKE, m_deadline, Clock::now());
+					return {REV_TIMER, 0};
+				}
+			}
+			else if (fd == m_signal_fd)
+			{
+				struct signalfd_siginfo info;
+				if (read(m_signal_fd, &info, sizeof(info)) == sizeof(info))
+				{
+					// Leave the event in place in case more signals are pending
+					--m_events_index;
+					return {REV_SIGNAL, static_cast<int>(info.ssi_signo)};
+				}
+			}
+			else if (fd == m_pipe[0])
+			{
+				char c;
+				if (read(m_pipe[0], &c, 1) == 1)
+				{
+					// Leave the event in place in case more commands are pending
+					--m_events_index;
+					return {REV_COMMAND, c};
+				}
+			}
+			else if (fd != -1)
+				return {REV_FD, fd};
+		}
+	}
+
+	// Adds fd to the epoll instance epoll_fd and throws an exception on error
+	static void try_epoll_add(int epoll_fd, int fd)
+	{
+		struct epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+		{
+			PERR("failed to watch file descriptor %d", fd);
+			throw EXCEPT_GENERIC;
+		}
+	}
+}
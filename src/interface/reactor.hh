@@ -0,0 +1,105 @@
+/*
+ * reactor.hh contains the event reactor that drives the terminal interfaces.
+ *
+ * A Reactor waits on a single epoll instance for any of the following:
+ * - a timerfd armed with an absolute deadline on the monotonic clock (REV_TIMER)
+ * - a signalfd receiving SIGWINCH, SIGCHLD, SIGTERM, SIGINT, and SIGHUP (REV_SIGNAL)
+ * - a self-pipe that other code can post single byte commands to (REV_COMMAND)
+ * - any other file descriptors added with watch(), such as stdin (REV_FD), or waiting for writability after watch_writable()
+ *
+ * The signals above are blocked while a Reactor exists so that they are only delivered through the signalfd.
+ *
+ * On a virtual clock (see clock_set_virtual() in tick.hh), an armed deadline is reached right away, and wait() sets the virtual time to it before returning the REV_TIMER event. This lets the terminal loop run through a section as fast as possible, which scripts/test_tick_alloc.cc uses.
+ */
+
+#pragma once
+
+#include <signal.h>	// For sigset_t
+
+#include "tick.hh"	// For Clock
+
+namespace pomocom
+{
+	// Types of events returned by Reactor::wait()
+	enum ReactorEventType{
+		// The deadline set with Reactor::arm() was reached
+		REV_TIMER,
+
+		// A signal was received, value is the signal number
+		REV_SIGNAL,
+
+		// A command was posted with Reactor::post(), value is the command
+		REV_COMMAND,
+
+		// A watched file descriptor is readable, or writable if it was switched with watch_writable(), value is the file descriptor
+		REV_FD,
+	};
+
+	// Commands that can be posted to a reactor
+	enum ReactorCommand{
+		RCMD_PAUSE,
+		RCMD_RESUME,
+		RCMD_SKIP,
+		RCMD_QUIT,
+	};
+
+	struct ReactorEvent{
+		ReactorEventType type;
+		int value;
+	};
+
+	struct Reactor{
+	private:
+		// Max # of epoll events fetched with one epoll_wait() call
+		static constexpr int EVENTS_MAX = 8;
+
+		int m_epoll_fd;
+		int m_timer_fd;
+		int m_signal_fd;
+
+		// Deadline set with the last arm() call, used to measure how late the timer fires
+		Clock::time_point m_deadline;
+
+		// Self-pipe, m_pipe[0] is the read end and m_pipe[1] is the write end
+		int m_pipe[2];
+
+		// Signal mask from before the reactor was created
+		sigset_t m_old_sigmask;
+
+		// Events returned by the last epoll_wait() call that haven't been handled yet
+		int m_events[EVENTS_MAX];
+		int m_events_len;
+		int m_events_index;
+
+		// Closes all file descriptors and restores the signal mask
+		void close_fds();
+	public:
+		Reactor();
+		~Reactor();
+
+		Reactor(const Reactor &) = delete;
+		Reactor &operator=(const Reactor &) = delete;
+
+		// Makes wait() return a REV_TIMER event once time point t is reached
+		void arm(Clock::time_point t);
+
+		// Cancels the deadline set with arm()
+		void disarm();
+
+		// Starts or stops watching fd for readability
+		// watch() returns false if fd can't be watched (ex. when it is a regular file)
+		bool watch(int fd);
+		void unwatch(int fd);
+
+		// Switches watched fd between waiting for writability and readability
+		// Returns false on error
+		bool watch_writable(int fd, bool writable);
+
+		// Sends cmd to the reactor
+		// This is safe to call from signal handlers and other threads
+		void post(ReactorCommand cmd);
+
+		// Waits for the next event
+		ReactorEvent wait();
+	};
+}
@@ -0,0 +1,120 @@
+/*
+ * simulate.cc contains the simulation interface.
+ *
+ * "pomocom --simulate (cycles)" runs the pomo file through the given # of cycles as fast as possible. A cycle ends each time the pomo file loops back to its first section. Sections are timed on a virtual clock (see clock_set_virtual() in tick.hh) that jumps straight to each screen update that the terminal interfaces would wake up for, and sections are switched with base_next_section() like the other interfaces do. Section commands are counted instead of run.
+ *
+ * Each section is written to stdout as one line:
+ * (time since the start as H:MM:SS)	(section #)	(kind)	(section name)	(section command)
+ * so the schedule of a pomo file can be checked by comparing the output with an expected one. A summary is written to stderr, including how many sections were simulated per second and the # of breaks before each long break.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "../command.hh"
+#include "../pomocom.hh"
+#include "../state.hh"
+#include "all.hh"
+#include "base.hh"
+#include "tick.hh"
+
+namespace pomocom
+{
+	// Names of section kinds written to stdout, the same words used in pomo files
+	static const char *simulate_kind_names[SECTION_MAX] = {"work", "break", "long"};
+
+	// # of section commands that would have been run
+	static long simulate_commands;
+
+	// Counts a section command instead of running it
+	static void simulate_record(const char *cmd);
+
+	// Runs the pomo file through cycles cycles on a virtual clock
+	void interface_simulate_loop(long cycles)
+	{
+		command_set_recorder(simulate_record);
+
+		// Start the virtual clock at its epoch so the output doesn't depend on when it was run
+		auto origin = Clock::time_point();
+		clock_set_virtual(origin);
+		auto real_start = std::chrono::steady_clock::now();
+
+		long sections = 0;
+		long ticks = 0;
+		long kinds[SECTION_MAX] = {};
+
+		// # of breaks since the last long break, and the fewest and most breaks seen before a long break
+		long breaks = 0;
+		long breaks_min = -1;
+		long breaks_max = -1;
+
+		std::string out;
+		for (long cycle = 0; cycle < cycles;)
+		{
+			const SectionInfo &si = state.sections[state.current_section];
+			auto time_start = Clock::now();
+			auto time_end = time_start + std::chrono::seconds(state.current_section_secs);
+
+			// Write the section
+			long elapsed = std::chrono::duration_cast<std::chrono::seconds>(time_start - origin).count();
+			char line[64];
+			std::snprintf(line, sizeof(line), "%ld:%02ld:%02ld\t%zu\t%s\t", elapsed / 3600, elapsed / 60 % 60, elapsed % 60,
+				state.current_section, simulate_kind_names[si.kind]);
+			out += line;
+			out += state.sections.name(si);
+			out += '\t';
+			out += state.sections.cmd(si);
+			out += '\n';
+			if (out.size() >= 1 << 16)
+			{
+				std::fwrite(out.data(), 1, out.size(), stdout);
+				out.clear();
+			}
+
+			// Wake up at every screen update like the terminal interfaces do
+			for (auto time_current = time_start; time_current < time_end; time_current = Clock::now())
+			{
+				clock_set_virtual(tick_next_update(time_end, time_current));
+				++ticks;
+			}
+
+			++sections;
+			++kinds[si.kind];
+			if (si.kind == SECTION_BREAK)
+				++breaks;
+			else if (si.kind == SECTION_BREAK_LONG)
+			{
+				if (breaks_min == -1 || breaks < breaks_min)
+					breaks_min = breaks;
+				if (breaks > breaks_max)
+					breaks_max = breaks;
+				breaks = 0;
+			}
+
+			base_next_section();
+			if (state.current_section == 0)
+				++cycle;
+		}
+		std::fwrite(out.data(), 1, out.size(), stdout);
+		std::fflush(stdout);
+
+		double real_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+		long elapsed = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - origin).count();
+		std::fprintf(stderr, "simulated %ld cycles, %ld sections (%ld work, %ld break, %ld long), %ld screen updates, and %ld section commands\n",
+			cycles, sections, kinds[SECTION_WORK], kinds[SECTION_BREAK], kinds[SECTION_BREAK_LONG], ticks, simulate_commands);
+		std::fprintf(stderr, "simulated time %ld:%02ld:%02ld in %.3fs real time (%.0f sections/s)\n",
+			elapsed / 3600, elapsed / 60 % 60, elapsed % 60, real_secs, real_secs > 0 ? sections / real_secs : 0.0);
+		if (breaks_min != -1)
+			std::fprintf(stderr, "breaks before each long break: %ld to %ld\n", breaks_min, breaks_max);
+
+		command_set_recorder(nullptr);
+	}
+
+	// Counts a section command instead of running it
+	static void simulate_record(const char *cmd)
+	{
+		if (cmd[0] != '\0')
+			++simulate_commands;
+	}
+}
@@ -0,0 +1,466 @@
+/*
+ * term.cc contains the timing loop shared by the terminal interfaces (ANSI and ncurses).
+ */
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <signal.h>
+#include <unistd.h>	// For STDIN_FILENO
+
+#include "../command.hh"
+#include "../error.hh"
+#include "../history.hh"
+#include "../jitter.hh"
+#include "../journal.hh"
+#include "../pomo.hh"
+#include "../reload.hh"
+#include "../startup.hh"
+#include "../state.hh"
+#include "../terminal_title.hh"
+#include "base.hh"
+#include "control.hh"
+#include "reactor.hh"
+#include "term.hh"
+#include "tick.hh"
+
+namespace pomocom
+{
+	// States of the terminal timing loop
+	enum TermState{
+		// Waiting for the section begin key to be pressed
+		TSTATE_UPCOMING,
+
+		// The section is being timed
+		TSTATE_RUNNING,
+
+		// The section is paused
+		TSTATE_PAUSED,
+	};
+
+	// Actions triggered by keys or reactor commands
+	enum TermAction{
+		TACTION_NONE,
+		TACTION_BEGIN,
+		TACTION_PAUSE,
+		TACTION_RESUME,
+		TACTION_SKIP,
+		TACTION_QUIT,
+	};
+
+	// Data used by the terminal timing loop
+	struct TermLoop{
+		const TermView &view;
+		Reactor reactor;
+		TermState tstate;
+
+		// End of the timing section
+		Clock::time_point time_end;
+
+		// When the section was last paused
+		Clock::time_point time_pause_start;
+
+		// Set when a control socket client asks the loop to exit
+		bool quit_requested;
+
+		TermLoop(const TermView &v) : view(v), quit_requested(false) {}
+
+		// Shows the current section, either as upcoming or by starting it
+		void enter_section();
+
+		// Shows the current section as upcoming and waits for it to be begun
+		void show_upcoming();
+
+		// Starts timing the current section
+		void begin_section();
+
+		// Prints the time left and schedules the next screen update
+		void update();
+
+		// Reprints the whole screen for the current state
+		void reprint();
+
+		// Returns the action triggered by key c in the current state
+		TermAction key_action(int c);
+
+		// Performs action a
+		// Returns false if the loop should exit
+		bool act(TermAction a);
+
+		// Returns the time left in the section in seconds
+		int secs_left();
+
+		// Handles a control socket request and appends the response to response
+		void request(std::string_view line, std::string &response);
+
+		// Reloads pomocom.conf and the pomo file if they changed and shows the changes
+		void reload();
+	};
+
+	// Name of the pomo file loaded through the control socket
+	// state.file_name points to this after a load request
+	static std::string loaded_file_name;
+
+	// Runs timing sections until the user quits or a terminating signal is received
+	void term_loop(const TermView &view)
+	{
+		TermLoop tl(view);
+		ControlServer server(tl.reactor);
+		ControlHandler handler = [&tl](std::string_view line, std::string &response)
+			{
+				tl.request(line, response);
+			};
+
+		// If stdin can't be watched (ex. it is /dev/null), run without keyboard controls
+		bool stdin_watched = tl.reactor.watch(STDIN_FILENO);
+
+		// Reload pomocom.conf and the pomo file when they are saved
+		int reload_fd = reload_open();
+		if (reload_fd != -1 && !tl.reactor.watch(reload_fd))
+		{
+			reload_close();
+			reload_fd = -1;
+		}
+		startup_mark("reactor, control socket");
+
+		// A section resumed from the journal continues the way it was left
+		switch (state.first_section)
+		{
+		case FIRST_SECTION_PAUSED: tl.show_upcoming(); break;
+		case FIRST_SECTION_RUNNING: tl.begin_section(); break;
+		default: tl.enter_section(); break;
+		}
+		startup_mark("first frame");
+		if (startup_profiling())
+			goto l_exit;
+
+		for (;;)
+		{
+			ReactorEvent ev = tl.reactor.wait();
+			switch (ev.type)
+			{
+			case REV_TIMER:
+				if (tl.tstate != TSTATE_RUNNING)
+					break;
+				if (auto time_current = Clock::now(); time_current >= tl.time_end)
+				{
+					jitter_record(JITTER_SECTION_END, tl.time_end, time_current);
+					base_next_section();
+					tl.enter_section();
+				}
+				else
+					tl.update();
+				break;
+			case REV_FD:
+				if (server.handle(ev.value, handler))
+				{
+					if (tl.quit_requested)
+						goto l_exit;
+					break;
+				}
+				if (ev.value == reload_fd)
+				{
+					tl.reload();
+					break;
+				}
+				if (ev.value != STDIN_FILENO)
+					break;
+
+				// Handle every key that is available
+				for (int c; (c = view.read_key()) != TERM_KEY_NONE;)
+				{
+					if (c == TERM_KEY_EOF)
+					{
+						// Stop watching stdin so that it isn't reported as readable forever
+						tl.reactor.unwatch(STDIN_FILENO);
+						stdin_watched = false;
+						break;
+					}
+					if (!tl.act(tl.key_action(c)))
+						goto l_exit;
+				}
+				break;
+			case REV_SIGNAL:
+				switch (ev.value)
+				{
+				case SIGCHLD:
+					command_notify_exit();
+					command_reap();
+					break;
+				case SIGWINCH:
+					view.resize();
+					tl.reprint();
+					break;
+				default:
+					// SIGTERM, SIGINT, or SIGHUP
+					goto l_exit;
+				}
+				break;
+			case REV_COMMAND:
+				{
+					TermAction a = TACTION_NONE;
+					switch (ev.value)
+					{
+					case RCMD_PAUSE: a = TACTION_PAUSE; break;
+					case RCMD_RESUME: a = TACTION_RESUME; break;
+					case RCMD_SKIP: a = TACTION_SKIP; break;
+					case RCMD_QUIT: a = TACTION_QUIT; break;
+					}
+					if (!tl.act(a))
+						goto l_exit;
+				}
+				break;
+			}
+		}
+	l_exit:
+		if (stdin_watched)
+			tl.reactor.unwatch(STDIN_FILENO);
+		if (reload_fd != -1)
+		{
+			tl.reactor.unwatch(reload_fd);
+			reload_close();
+		}
+	}
+
+	// Shows the current section, either as upcoming or by starting it
+	void TermLoop::enter_section()
+	{
+		if (state.settings.pause_before_section_start)
+			show_upcoming();
+		else
+			begin_section();
+	}
+
+	// Shows the current section as upcoming and waits for it to be begun
+	void TermLoop::show_upcoming()
+	{
+		tstate = TSTATE_UPCOMING;
+		reactor.disarm();
+		base_publish_paused(state.current_section_secs);
+		reprint();
+	}
+
+	// Starts timing the current section
+	void TermLoop::begin_section()
+	{
+		tstate = TSTATE_RUNNING;
+		time_end = Clock::now() + std::chrono::seconds(state.current_section_secs);
+		base_publish_running(time_end);
+		reprint();
+	}
+
+	// Prints the time left and schedules the next screen update
+	void TermLoop::update()
+	{
+		auto time_current = Clock::now();
+		int time_left = tick_secs_left(time_end, time_current);
+		int mins = time_left / 60;
+		int secs = time_left % 60;
+
+		view.print_time_left(mins, secs, false);
+		if (state.settings.set_terminal_title_countdown)
+			base_set_terminal_title_countdown(mins, secs, state.sections.name(state.sections[state.current_section]));
+		view.flush();
+
+		reactor.arm(tick_next_update(time_end, time_current));
+	}
+
+	// Reprints the whole screen for the current state
+	void TermLoop::reprint()
+	{
+		switch (tstate)
+		{
+		case TSTATE_UPCOMING:
+			view.print_upcoming_section(state.sections[state.current_section]);
+			view.flush();
+			break;
+		case TSTATE_RUNNING:
+			view.print_section();
+			update();
+			break;
+		case TSTATE_PAUSED:
+			{
+				int time_left = secs_left();
+				view.print_section();
+				view.print_time_left(time_left / 60, time_left % 60, true);
+				view.flush();
+			}
+			break;
+		}
+	}
+
+	// Returns the action triggered by key c in the current state
+	TermAction TermLoop::key_action(int c)
+	{
+		auto &key = state.settings.key;
+
+		if (c == key.quit)
+			return TACTION_QUIT;
+
+		switch (tstate)
+		{
+		case TSTATE_UPCOMING:
+			if (c == key.section_begin)
+				return TACTION_BEGIN;
+			if (c == key.section_skip)
+				return TACTION_SKIP;
+			break;
+		case TSTATE_RUNNING:
+			if (c == key.pause)
+				return TACTION_PAUSE;
+			if (c == key.section_skip)
+				return TACTION_SKIP;
+			break;
+		case TSTATE_PAUSED:
+			if (c == key.pause)
+				return TACTION_RESUME;
+			break;
+		}
+		return TACTION_NONE;
+	}
+
+	// Performs action a
+	// Returns false if the loop should exit
+	bool TermLoop::act(TermAction a)
+	{
+		switch (a)
+		{
+		case TACTION_NONE:
+			break;
+		case TACTION_BEGIN:
+			if (tstate == TSTATE_UPCOMING)
+				begin_section();
+			break;
+		case TACTION_PAUSE:
+			if (tstate != TSTATE_RUNNING)
+				break;
+			tstate = TSTATE_PAUSED;
+			time_pause_start = Clock::now();
+			reactor.disarm();
+			base_publish_paused(secs_left());
+			reprint();
+			break;
+		case TACTION_RESUME:
+			if (tstate != TSTATE_PAUSED)
+				break;
+			tstate = TSTATE_RUNNING;
+
+			// Extend time_end to include the time spent paused
+			time_end += Clock::now() - time_pause_start;
+			base_publish_running(time_end);
+			update();
+			break;
+		case TACTION_SKIP:
+			base_skip_section(tstate == TSTATE_UPCOMING ? 0 : state.current_section_secs - secs_left());
+			enter_section();
+			break;
+		case TACTION_QUIT:
+			return false;
+		}
+		return true;
+	}
+
+	// Returns the time left in the section in seconds
+	int TermLoop::secs_left()
+	{
+		return tick_secs_left(time_end, tstate == TSTATE_PAUSED ? time_pause_start : Clock::now());
+	}
+
+	// Handles a control socket request and appends the response to response
+	void TermLoop::request(std::string_view line, std::string &response)
+	{
+		// Split the line into the request name and its argument
+		std::size_t space = line.find(' ');
+		std::string_view name = line.substr(0, space);
+		std::string_view arg = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+		if (name == "status")
+		{
+			// An upcoming section hasn't started, so all of its time is left
+			const SectionInfo &si = state.sections[state.current_section];
+			int time_left = tstate == TSTATE_UPCOMING ? state.current_section_secs : secs_left();
+			response += "ok 0 " + std::to_string(si.kind) +
+				' ' + (tstate == TSTATE_PAUSED ? '1' : '0') +
+				' ' + std::to_string(time_left) +
+				' ' + state.sections.name(si) + '\n';
+			return;
+		}
+
+		if (name == "pause")
+			act(tstate == TSTATE_UPCOMING ? TACTION_NONE : TACTION_PAUSE);
+		else if (name == "resume")
+			act(tstate == TSTATE_UPCOMING ? TACTION_BEGIN : TACTION_RESUME);
+		else if (name == "skip")
+			act(TACTION_SKIP);
+		else if (name == "quit")
+			quit_requested = true;
+		else if (name == "load")
+		{
+			if (arg.empty())
+			{
+				response += "err no pomo file specified\n";
+				return;
+			}
+
+			// Read into a copy so that the current sections are kept if reading fails
+			std::string file_name(arg);
+			SectionTable sections;
+			try{ pomo_read(file_name.c_str(), sections); }
+			catch (Exception &e)
+			{
+				response += "err failed to read pomo file\n";
+				return;
+			}
+
+			state.sections = std::move(sections);
+			loaded_file_name = std::move(file_name);
+			state.file_name = loaded_file_name.c_str();
+			state.current_section = 0;
+			state.current_section_secs = state.sections[0].secs;
+			journal_open(state.file_name);
+			history_open(state.file_name);
+			reload_set_kind_secs(nullptr);
+			reload_watch_pomo();
+
+			if (state.settings.set_terminal_title)
+			{
+				std::stringstream title;
+				title << "pomocom - " << state.file_name;
+				set_terminal_title(title.view());
+			}
+			enter_section();
+		}
+		else
+		{
+			response += "err unknown request\n";
+			return;
+		}
+
+		response += "ok\n";
+	}
+
+	// Reloads pomocom.conf and the pomo file if they changed and shows the changes
+	void TermLoop::reload()
+	{
+		ReloadResult r = reload_handle();
+		if (!r.settings && !r.sections)
+			return;
+
+		if (r.settings && view.reload != nullptr)
+			view.reload();
+
+		// The section keeps its deadline unless its length was edited
+		// An upcoming section's length is read from state.current_section_secs when it begins
+		if (tstate != TSTATE_UPCOMING)
+			time_end += std::chrono::seconds(r.secs_delta);
+		if (tstate == TSTATE_RUNNING)
+			base_publish_running(time_end);
+		else
+			base_publish_paused(tstate == TSTATE_UPCOMING ? state.current_section_secs : secs_left());
+
+		// The screen is reprinted with the new settings, which also reschedules the next update for the new deadline
+		reprint();
+	}
+}
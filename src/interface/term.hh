@@ -0,0 +1,46 @@
+/*
+ * term.hh contains the timing loop shared by the terminal interfaces (ANSI and ncurses).
+ *
+ * term_loop() runs on a Reactor (see reactor.hh) and handles section timing, pausing, skipping, and signals. Each terminal interface only provides a TermView, which is a set of functions for drawing the screen and reading keys.
+ */
+
+#pragma once
+
+#include "../pomocom.hh"	// For SectionInfo
+
+namespace pomocom
+{
+	// Values returned by TermView::read_key() when there is no key to return
+	constexpr int TERM_KEY_NONE = -1;
+	constexpr int TERM_KEY_EOF = -2;
+
+	// Functions used by term_loop() to draw the screen and read keys
+	struct TermView{
+		// Print info about the upcoming section
+		void (*print_upcoming_section)(const SectionInfo &si);
+
+		// Clear the screen and print the header and current section name
+		void (*print_section)();
+
+		// Print the time left in a section
+		void (*print_time_left)(int mins, int secs, bool paused);
+
+		// Make sure everything printed so far is shown
+		void (*flush)();
+
+		// Handle the terminal being resized
+		// The screen is reprinted after this is called
+		void (*resize)();
+
+		// Apply settings that were reloaded (see reload.hh), or nullptr if the view reads every setting it uses when drawing
+		// The screen is reprinted after this is called
+		void (*reload)();
+
+		// Returns the next key pressed without blocking
+		// Returns TERM_KEY_NONE if no keys are left to read and TERM_KEY_EOF if input was closed
+		int (*read_key)();
+	};
+
+	// Runs timing sections until the user quits or a terminating signal is received
+	void term_loop(const TermView &view);
+}
@@ -0,0 +1,109 @@
+/*
+ * tick.cc contains functions for scheduling screen updates in the terminal interfaces.
+ */
+
+#include <array>
+#include <chrono>
+#include <cstring>	// For std::memcpy()
+
+#include "../state.hh"
+#include "tick.hh"
+
+namespace chrono = std::chrono;
+
+namespace pomocom
+{
+	// Two digit strings for every number from 0 to 99, so formatting a number takes one table lookup per two digits
+	static constexpr auto digit_pairs = []()
+		{
+			std::array<char, 200> pairs{};
+			for (int i = 0; i < 100; ++i)
+			{
+				pairs[i * 2] = '0' + i / 10;
+				pairs[i * 2 + 1] = '0' + i % 10;
+			}
+			return pairs;
+		}();
+
+	// Writes the decimal digits of n to buf
+	// Returns the # of chars written
+	static int tick_format_uint(char *buf, unsigned n);
+
+	// std::chrono::steady_clock must be CLOCK_MONOTONIC for timerfd deadlines to match Clock::now()
+	static_assert(std::chrono::steady_clock::is_steady);
+
+	// True if Clock::now() returns clock_virtual_now instead of reading the monotonic clock
+	bool clock_virtual = false;
+	Clock::time_point clock_virtual_now;
+
+	// Makes Clock::now() return t until the virtual time is set again
+	void clock_set_virtual(Clock::time_point t)
+	{
+		clock_virtual = true;
+		clock_virtual_now = t;
+	}
+
+	// Returns the # of seconds left before time_end, rounded up
+	// This is the value displayed on the screen
+	int tick_secs_left(Clock::time_point time_end, Clock::time_point time_current)
+	{
+		if (time_current >= time_end)
+			return 0;
+		return chrono::ceil<chrono::seconds>(time_end - time_current).count();
+	}
+
+	// Returns the next time point after time_current where the displayed time left changes
+	// Updates are spaced by the update_interval setting and never scheduled after time_end
+	Clock::time_point tick_next_update(Clock::time_point time_end, Clock::time_point time_current)
+	{
+		int secs_left = tick_secs_left(time_end, time_current);
+
+		// The displayed value changes from secs_left to secs_left - 1 at time_end - (secs_left - 1) seconds
+		// With a longer update interval, skip ahead to the change that is update_interval seconds away
+		long interval = state.settings.update_interval > 0 ? state.settings.update_interval : 1;
+		long secs_left_next = secs_left - interval;
+		if (secs_left_next < 0)
+			secs_left_next = 0;
+
+		return time_end - chrono::seconds(secs_left_next);
+	}
+
+	// Writes the time left as "(mins)m (secs)s" to buf without allocating or null terminating it
+	// buf must have room for TICK_TIME_LEN_MAX chars
+	// Returns the # of chars written
+	int tick_format_time(char *buf, int mins, int secs)
+	{
+		int len = tick_format_uint(buf, mins > 0 ? mins : 0);
+		buf[len++] = 'm';
+		buf[len++] = ' ';
+		len += tick_format_uint(buf + len, secs > 0 ? secs : 0);
+		buf[len++] = 's';
+		return len;
+	}
+
+	// Writes the decimal digits of n to buf
+	// Returns the # of chars written
+	static int tick_format_uint(char *buf, unsigned n)
+	{
+		// Fill a temporary buffer from the end, two digits at a time
+		char digits[10];
+		char *p = digits + sizeof(digits);
+		while (n >= 100)
+		{
+			p -= 2;
+			std::memcpy(p, &digit_pairs[(n % 100) * 2], 2);
+			n /= 100;
+		}
+		if (n >= 10)
+		{
+			p -= 2;
+			std::memcpy(p, &digit_pairs[n * 2], 2);
+		}
+		else
+			*--p = '0' + n;
+
+		int len = digits + sizeof(digits) - p;
+		std::memcpy(buf, p, len);
+		return len;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * tick.hh contains functions for scheduling screen updates in the terminal interfaces.
+ *
+ * Instead of waking up every update_interval seconds, the interfaces compute the next instant that the time left on the screen actually changes and wait until that absolute time point on the monotonic clock (see Reactor::arm() in reactor.hh). This keeps the countdown from drifting and avoids waking up when nothing visible would change.
+ *
+ * Clock::now() normally reads the monotonic clock, but after clock_set_virtual() it returns a virtual time that only moves when it is set again. "pomocom --simulate" uses this to run sections as fast as possible (see simulate.cc).
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace pomocom
+{
+	// Monotonic clock used for timing sections
+	// Its time points are std::chrono::steady_clock time points, so they can be passed to code that takes those
+	// Declare them as Clock::time_point, since std::chrono::time_point<Clock> is a different type that Clock::now() doesn't return
+	struct Clock{
+		using duration = std::chrono::steady_clock::duration;
+		using rep = duration::rep;
+		using period = duration::period;
+		using time_point = std::chrono::steady_clock::time_point;
+		static constexpr bool is_steady = true;
+
+		// Returns the current time, or the virtual time if one was set
+		static time_point now();
+	};
+
+	// True if Clock::now() returns clock_virtual_now instead of reading the monotonic clock
+	extern bool clock_virtual;
+	extern Clock::time_point clock_virtual_now;
+
+	// Makes Clock::now() return t until the virtual time is set again
+	void clock_set_virtual(Clock::time_point t);
+
+	// Returns the current time, or the virtual time if one was set
+	inline Clock::time_point Clock::now()
+	{
+		return clock_virtual ? clock_virtual_now : std::chrono::steady_clock::now();
+	}
+
+	// Returns the # of seconds left before time_end, rounded up
+	// This is the value displayed on the screen
+	int tick_secs_left(Clock::time_point time_end, Clock::time_point time_current);
+
+	// Returns the next time point after time_current where the displayed time left changes
+	// Updates are spaced by the update_interval setting and never scheduled after time_end
+	Clock::time_point tick_next_update(Clock::time_point time_end, Clock::time_point time_current);
+
+	// Max # of chars written by tick_format_time()
+	constexpr int TICK_TIME_LEN_MAX = 24;
+
+	// Writes the time left as "(mins)m (secs)s" to buf without allocating or null terminating it
+	// buf must have room for TICK_TIME_LEN_MAX chars
+	// Returns the # of chars written
+	int tick_format_time(char *buf, int mins, int secs);
+}
@@ -2,28 +2,46 @@
  * wx.cc contains code for the wxWidgets interface.
  *
  * This interface utilizes a wxTimer object to periodically display the time remaining, and wxButton objects to implement basic controls
+ *
+ * While the frame is iconized or hidden, nothing it shows can be seen, so the wxTimer stops firing periodically and is only armed once for the section deadline. When the frame is shown again, the time left is computed from the deadline and the periodic updates start again.
+ *
+ * The time remaining is drawn by a CountdownCtrl instead of a wxStaticText, so changing it doesn't lay out the frame again. The control renders the characters it can show once into a glyph atlas bitmap, sized to fill the control, and on each tick only invalidates the rectangles of the characters that changed. Painting copies those characters out of the atlas into a double-buffered DC.
+ *
+ * Everything that reads or changes the global state, writes files, or spawns processes (switching sections, publishing to the status page and journal, and reaping section commands) runs on a SectionWorker thread, so the window keeps repainting and counting down while a journal fsync or a section command's spawn is slow. The worker hands the new section back to the GUI thread with CallAfter().
  */
 
+#include <algorithm>	// For std::copy(), std::equal(), and std::fill()
 #include <chrono>
+#include <climits>	// For INT_MAX
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 
 #include <wx/wx.h>
 #include <wx/hyperlink.h>
 #include <wx/artprov.h>
+#include <wx/dcbuffer.h>	// For wxAutoBufferedPaintDC
+#include <wx/dcmemory.h>
 
+#include "../command.hh"
+#include "../jitter.hh"
 #include "../pomocom.hh" // For SectionInfo
+#include "../startup.hh"
 #include "../state.hh"
 #include "all.hh"
 #include "base.hh"
+#include "tick.hh"	// For Clock
 
 namespace chrono = std::chrono;
 
 namespace pomocom
 {
-	using Clock = chrono::high_resolution_clock;
-
 	// String literals
 	
 	// Image filenames
@@ -89,37 +107,134 @@ namespace pomocom
 		TimerState state;
 		
 		// Start of the timing section
-		chrono::time_point<Clock> start;
+		Clock::time_point start;
 		
 		// End of the timing section
-		chrono::time_point<Clock> end;
+		Clock::time_point end;
 		
 		// When the wxTimer was last paused at
-		chrono::time_point<Clock> pause_start;
+		Clock::time_point pause_start;
 	};
 
+	// Characters that a CountdownCtrl renders into its glyph atlas, which are all the characters that tick_format_time() and the " left" suffix write
+	constexpr std::string_view COUNTDOWN_GLYPHS = "0123456789ms left";
+
+	// Max # of chars shown by a CountdownCtrl
+	constexpr int COUNTDOWN_LEN_MAX = TICK_TIME_LEN_MAX + 5;
+
 	// About window
 	struct AboutWin : public wxDialog{
 		AboutWin();
 	};
 
+	// Control that displays the time left in large characters copied from a glyph atlas
+	struct CountdownCtrl : public wxWindow{
+	private:
+		// Bitmap holding each char in COUNTDOWN_GLYPHS side by side, and a DC that stays selected on it for copying from
+		wxBitmap m_atlas;
+		wxMemoryDC m_atlas_dc;
+
+		// X position and width in m_atlas of each char, indexed by the char, or a width of 0 if the char isn't in the atlas
+		int m_glyph_x[128];
+		int m_glyph_w[128];
+
+		// Height of the glyphs in pixels, which the atlas was rendered at
+		int m_glyph_h;
+
+		// Chars shown, or a length of 0 if m_message is shown instead
+		char m_text[COUNTDOWN_LEN_MAX];
+		int m_len;
+
+		// X position in the control of each char in m_text, and of the end of the last char
+		int m_text_x[COUNTDOWN_LEN_MAX + 1];
+
+		// Text shown when the time left isn't
+		wxString m_message;
+
+		// Renders the glyph atlas at the largest size that fits the control
+		// The atlas isn't built while the control has no size
+		void build_atlas();
+
+		// Sets m_text_x to center m_text in the control
+		void layout_text();
+
+		// Returns the rectangle in the control covered by char i of m_text
+		wxRect char_rect(int i) const;
+
+		void on_paint(wxPaintEvent &e);
+		void on_size(wxSizeEvent &e);
+	public:
+		CountdownCtrl(wxWindow *parent, wxWindowID id);
+
+		// Shows mins and secs left
+		// Only the chars that changed are repainted
+		void set_time(int mins, int secs);
+
+		// Shows message instead of the time left
+		void set_message(const wxString &message);
+	};
+
+	// Thread that runs jobs posted by the GUI thread in the order they were posted
+	struct SectionWorker{
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+
+		// Jobs that haven't been run yet
+		std::deque<std::function<void()>> m_jobs;
+
+		// Set when the thread should exit after running the jobs left
+		bool m_quit;
+
+		// Declared last so that it starts after the members above are initialized
+		std::thread m_thread;
+
+		// Runs jobs until m_quit is set
+		void run();
+	public:
+		SectionWorker();
+		~SectionWorker();
+
+		// Runs the jobs left and joins the thread
+		// Jobs posted after this are never run
+		void stop();
+
+		// Runs job on the worker thread after the jobs posted before it
+		void post(std::function<void()> job);
+	};
+
 	// Frame created when the app starts
 	struct MainFrame : public wxFrame{
 	private:
 		TimerData m_timer_data;
 		
-		// Info on the current section
-		SectionInfo *m_si;
+		// Name and length in secs of the current section
+		// These are copies of the global state, which is only touched by m_worker after the frame is created
+		std::string m_section_name;
+		int m_section_secs;
 
 		// Used to handle periodic text updating
 		int m_timer_interval;
 		wxTimer m_timer;
 
+		// When m_timer is meant to fire next, used to measure how late it fires
+		Clock::time_point m_timer_due;
+
+		// True while the frame is iconized, and while it is shown
+		bool m_iconized;
+		bool m_shown;
+
+		// True if m_timer was last started to fire only at the section deadline because the frame can't be seen
+		bool m_hidden;
+
 		// Button that controls starting the timing section, pausing, and unpausing
 		wxButton *m_btn_pause;
 
 		// Displays the time left in the timing section
-		wxStaticText *m_txt_time;
+		CountdownCtrl *m_countdown;
+
+		// Secs left shown in m_countdown, or -1 if m_countdown shows something else
+		int m_time_left_shown;
 
 		// Displays the name of the timing section
 		wxStaticText *m_txt_section;
@@ -127,40 +242,287 @@ namespace pomocom
 		// About window
 		AboutWin m_about_win;
 
-		// Updates m_txt_time to show the time left in the timing section
-		void update_txt_time(chrono::time_point<Clock> &time_current);
+		// Runs section switches, publishing, and command reaping
+		// Stopped in the destructor, so it is joined before the widgets it calls back to are destroyed
+		SectionWorker m_worker;
+
+		// Updates m_countdown to show the time left in the timing section
+		void update_txt_time(Clock::time_point &time_current);
 
 		// Runs when m_btn_pause is clicked
 		void on_btn_pause(wxCommandEvent &e);
 
-		// Runs every m_timer_interval milliseconds when the timer is running
+		// Runs every m_timer_interval milliseconds when the timer is running, or only at the section deadline while the frame is hidden
 		// Calls update_txt_time if time isn't up yet
-
 		void on_timer(wxTimerEvent &e);
 
+		// Starts m_timer firing every m_timer_interval milliseconds, or only once at the section deadline if the frame is iconized or hidden
+		void start_timer();
+
 		// Runs when the wxTimer fails to start
 		void on_timer_error();
 
+		// Switches m_timer between periodic updates and the section deadline after the frame is iconized, restored, hidden, or shown
+		void on_visibility_changed();
+
+		void on_iconize(wxIconizeEvent &e);
+		void on_show(wxShowEvent &e);
+
+		// Runs on the GUI thread once m_worker has switched to the section named name that is secs long
+		void on_section_switched(std::string name, int secs);
+
 		void on_about(wxCommandEvent &e);
 		void on_exit(wxCommandEvent &e);
 	public:
 		MainFrame();
+
+		// Stops m_timer and m_worker before any member or widget is destroyed
+		~MainFrame();
 	};
 
-	// Updates m_txt_time to show the time left in the timing section
-	void MainFrame::update_txt_time(chrono::time_point<Clock> &time_current)
+	SectionWorker::SectionWorker()
+		: m_quit(false), m_thread(&SectionWorker::run, this)
+	{
+	}
+
+	SectionWorker::~SectionWorker()
+	{
+		stop();
+	}
+
+	// Runs the jobs left and joins the thread
+	// Jobs posted after this are never run
+	void SectionWorker::stop()
+	{
+		if (!m_thread.joinable())
+			return;
+		{
+			std::lock_guard lock(m_mutex);
+			m_quit = true;
+		}
+		m_cv.notify_one();
+		m_thread.join();
+	}
+
+	// Runs job on the worker thread after the jobs posted before it
+	void SectionWorker::post(std::function<void()> job)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_cv.notify_one();
+	}
+
+	// Runs jobs until m_quit is set
+	void SectionWorker::run()
+	{
+		std::unique_lock lock(m_mutex);
+		for (;;)
+		{
+			m_cv.wait(lock, [this]{ return m_quit || !m_jobs.empty(); });
+			if (m_jobs.empty())
+				return;
+
+			// Let the GUI thread post more jobs while this one runs
+			std::function<void()> job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			lock.unlock();
+			job();
+			lock.lock();
+		}
+	}
+
+	CountdownCtrl::CountdownCtrl(wxWindow *parent, wxWindowID id)
+		: wxWindow(parent, id, wxDefaultPosition, wxSize(200, 48)), m_glyph_h(0), m_len(0), m_message(S_TXT_TIME_INIT)
+	{
+		// Everything is drawn in on_paint(), so the background doesn't need to be erased first
+		SetBackgroundStyle(wxBG_STYLE_PAINT);
+		SetBackgroundColour(parent->GetBackgroundColour());
+		SetForegroundColour(parent->GetForegroundColour());
+		SetMinSize(wxSize(200, 48));
+		std::fill(std::begin(m_glyph_w), std::end(m_glyph_w), 0);
+
+		Bind(wxEVT_PAINT, &CountdownCtrl::on_paint, this);
+		Bind(wxEVT_SIZE, &CountdownCtrl::on_size, this);
+	}
+
+	// Shows mins and secs left
+	// Only the chars that changed are repainted
+	void CountdownCtrl::set_time(int mins, int secs)
+	{
+		constexpr std::string_view left_str = " left";
+		char text[COUNTDOWN_LEN_MAX];
+		int len = tick_format_time(text, mins, secs);
+		left_str.copy(text + len, left_str.size());
+		len += left_str.size();
+
+		// The control may be shown before its first wxEVT_SIZE, so build the atlas here if it wasn't yet
+		if (!m_atlas.IsOk())
+			build_atlas();
+
+		// A different length moves every char, so repaint all of them
+		// Without an atlas, chars have no width yet, and on_paint() draws the text instead
+		if (len != m_len || !m_atlas.IsOk())
+		{
+			std::copy(text, text + len, m_text);
+			m_len = len;
+			layout_text();
+			Refresh(false);
+			return;
+		}
+
+		// Remember which chars changed before replacing them
+		bool changed[COUNTDOWN_LEN_MAX];
+		for (int i = 0; i < len; ++i)
+			changed[i] = text[i] != m_text[i];
+		int text_x[COUNTDOWN_LEN_MAX + 1];
+		std::copy(m_text_x, m_text_x + len + 1, text_x);
+		std::copy(text, text + len, m_text);
+		layout_text();
+
+		// Digits have the same width in most fonts, so usually no char moves and only the changed ones are repainted
+		if (!std::equal(m_text_x, m_text_x + len + 1, text_x))
+		{
+			Refresh(false);
+			return;
+		}
+		for (int i = 0; i < len; ++i)
+			if (changed[i])
+				RefreshRect(char_rect(i), false);
+	}
+
+	// Shows message instead of the time left
+	void CountdownCtrl::set_message(const wxString &message)
+	{
+		m_message = message;
+		m_len = 0;
+		Refresh(false);
+	}
+
+	// Renders the glyph atlas at the largest size that fits the control
+	// The atlas isn't built while the control has no size
+	void CountdownCtrl::build_atlas()
+	{
+		wxSize size = GetClientSize();
+		if (size.x <= 0 || size.y <= 0)
+			return;
+
+		// Fit the height first, then shrink the font if the widest text the control shows wouldn't fit
+		// Text is measured in the control's font
+		wxFont font = GetFont();
+		font.SetPixelSize(wxSize(0, size.y * 3 / 4));
+		SetFont(font);
+		int widest = GetTextExtent("00m 00s left").x;
+		if (widest > size.x)
+		{
+			font.SetPixelSize(wxSize(0, size.y * 3 / 4 * size.x / widest));
+			SetFont(font);
+		}
+
+		// Lay out the glyphs side by side
+		int atlas_w = 0;
+		std::fill(std::begin(m_glyph_w), std::end(m_glyph_w), 0);
+		m_glyph_h = 1;
+		for (char c : COUNTDOWN_GLYPHS)
+		{
+			if (m_glyph_w[static_cast<unsigned char>(c)] != 0)
+				continue;
+			wxSize extent = GetTextExtent(wxString(c));
+			m_glyph_x[static_cast<unsigned char>(c)] = atlas_w;
+			m_glyph_w[static_cast<unsigned char>(c)] = extent.x > 0 ? extent.x : 1;
+			atlas_w += m_glyph_w[static_cast<unsigned char>(c)];
+			if (extent.y > m_glyph_h)
+				m_glyph_h = extent.y;
+		}
+
+		// Render them once in the control's colors
+		m_atlas_dc.SelectObject(wxNullBitmap);
+		m_atlas = wxBitmap(atlas_w, m_glyph_h);
+		m_atlas_dc.SelectObject(m_atlas);
+		m_atlas_dc.SetBackground(wxBrush(GetBackgroundColour()));
+		m_atlas_dc.Clear();
+		m_atlas_dc.SetFont(font);
+		m_atlas_dc.SetTextForeground(GetForegroundColour());
+		for (char c : COUNTDOWN_GLYPHS)
+			m_atlas_dc.DrawText(wxString(c), m_glyph_x[static_cast<unsigned char>(c)], 0);
+	}
+
+	// Sets m_text_x to center m_text in the control
+	void CountdownCtrl::layout_text()
+	{
+		int width = 0;
+		for (int i = 0; i < m_len; ++i)
+			width += m_glyph_w[static_cast<unsigned char>(m_text[i])];
+
+		int x = (GetClientSize().x - width) / 2;
+		for (int i = 0; i < m_len; ++i)
+		{
+			m_text_x[i] = x;
+			x += m_glyph_w[static_cast<unsigned char>(m_text[i])];
+		}
+		m_text_x[m_len] = x;
+	}
+
+	// Returns the rectangle in the control covered by char i of m_text
+	wxRect CountdownCtrl::char_rect(int i) const
+	{
+		return wxRect(m_text_x[i], (GetClientSize().y - m_glyph_h) / 2, m_text_x[i + 1] - m_text_x[i], m_glyph_h);
+	}
+
+	void CountdownCtrl::on_paint([[maybe_unused]] wxPaintEvent &e)
+	{
+		// Drawing is clipped to the invalidated rectangles, so clearing only touches those
+		wxAutoBufferedPaintDC dc(this);
+		dc.SetBackground(wxBrush(GetBackgroundColour()));
+		dc.Clear();
+
+		if (m_len == 0 || !m_atlas.IsOk())
+		{
+			// Messages change rarely, so they are drawn as text instead of from the atlas
+			// So is the time left when it is painted before the atlas could be built, since there is nothing to copy from yet
+			wxString text = m_len == 0 ? m_message : wxString::FromAscii(m_text, m_len);
+			dc.SetFont(GetFont());
+			dc.SetTextForeground(GetForegroundColour());
+			wxSize extent = dc.GetTextExtent(text);
+			wxSize size = GetClientSize();
+			dc.DrawText(text, (size.x - extent.x) / 2, (size.y - extent.y) / 2);
+			return;
+		}
+
+		// Copy the chars that need repainting out of the atlas
+		const wxRegion &update = GetUpdateRegion();
+		for (int i = 0; i < m_len; ++i)
+		{
+			wxRect rect = char_rect(i);
+			if (update.Contains(rect) == wxOutRegion)
+				continue;
+			dc.Blit(rect.x, rect.y, rect.width, rect.height, &m_atlas_dc, m_glyph_x[static_cast<unsigned char>(m_text[i])], 0);
+		}
+	}
+
+	void CountdownCtrl::on_size(wxSizeEvent &e)
+	{
+		// The glyphs are only rendered again when the control is resized, such as when the frame goes fullscreen
+		build_atlas();
+		layout_text();
+		Refresh(false);
+		e.Skip();
+	}
+
+	// Updates m_countdown to show the time left in the timing section
+	void MainFrame::update_txt_time(Clock::time_point &time_current)
 	{
 		// Time left in the section in seconds
-		int time_left = chrono::ceil<chrono::seconds>(m_timer_data.end - time_current).count();
+		int time_left = tick_secs_left(m_timer_data.end, time_current);
+
+		// The wxTimer fires more often than the time left changes, so only update m_countdown when it would be different
+		if (time_left == m_time_left_shown)
+			return;
+		m_time_left_shown = time_left;
 		
 		// Minutes and seconds left
-		int mins = time_left / 60;
-		int secs = time_left % 60;
-		
-		// Set the new label for the time left widget
-		std::stringstream label;
-		label << mins << "m " << secs << "s left";
-		m_txt_time->SetLabel(label.str());
+		m_countdown->set_time(time_left / 60, time_left % 60);
 	}
 
 	// Runs when m_btn_pause is clicked
@@ -173,15 +535,15 @@ namespace pomocom
 			
 			// Set the start and end times of the section
 			m_timer_data.start = Clock::now();
-			m_timer_data.end = m_timer_data.start + chrono::seconds(m_si->secs);
+			m_timer_data.end = m_timer_data.start + chrono::seconds(m_section_secs);
+			m_worker.post([end = m_timer_data.end]{ base_publish_running(end); });
 			
 			// Start the wxTimer
-			if (m_timer.Start(m_timer_interval) == false)
-				on_timer_error();
+			start_timer();
 			
 			// Update the UI
 			update_txt_time(m_timer_data.start);
-			m_txt_section->SetLabel(m_si->name);
+			m_txt_section->SetLabel(m_section_name);
 			m_btn_pause->SetLabel(S_BTN_PAUSE);
 			SetStatusText(S_STATUS_TIME_STARTED);
 			
@@ -192,6 +554,7 @@ namespace pomocom
 			// Pause the timer
 			
 			m_timer_data.pause_start = Clock::now();
+			m_worker.post([secs_left = chrono::ceil<chrono::seconds>(m_timer_data.end - m_timer_data.pause_start).count()]{ base_publish_paused(secs_left); });
 			
 			// Stop the wxTimer
 			m_timer.Stop();
@@ -208,10 +571,10 @@ namespace pomocom
 			
 			// Add the time spent paused to the end time
 			m_timer_data.end += Clock::now() - m_timer_data.pause_start;
+			m_worker.post([end = m_timer_data.end]{ base_publish_running(end); });
 			
 			// Restart the wxTimer
-			if (m_timer.Start(m_timer_interval) == false)
-				on_timer_error();
+			start_timer();
 			
 			// Update the UI
 			m_btn_pause->SetLabel(S_BTN_PAUSE);
@@ -227,33 +590,78 @@ namespace pomocom
 		}
 	}
 	
-	// Runs every m_timer_interval milliseconds when the timer is running
+	// Runs every m_timer_interval milliseconds when the timer is running, or only at the section deadline while the frame is hidden
 	// Calls update_txt_time if time isn't up yet
 	void MainFrame::on_timer([[maybe_unused]] wxTimerEvent &e)
 	{
 		auto time_current = Clock::now();
+		jitter_record(JITTER_WAKE, m_timer_due, time_current);
+
+		// A periodic wxTimer is due again an interval after it fired
+		m_timer_due = time_current + chrono::milliseconds(m_timer_interval);
+
+		// Check on section commands started by earlier sections, only once one of them has exited
+		if (command_exited())
+			m_worker.post(command_reap);
 		
 		if (time_current >= m_timer_data.end)
 		{
-			// Move to the next timing section
-			base_next_section();
-			m_si = &state.section_info[state.current_section];
+			jitter_record(JITTER_SECTION_END, m_timer_data.end, time_current);
+
+			// Move to the next timing section, which spawns its command and writes the history, status page, and journal
+			// The next section can't be started until the worker hands it back to on_section_switched()
+			m_worker.post([this]
+				{
+					base_next_section();
+					const SectionInfo &si = state.sections[state.current_section];
+					CallAfter([this, name = std::string(state.sections.name(si)), secs = state.current_section_secs]{ on_section_switched(name, secs); });
+				});
 			
 			// Stop the wxTimer
 			m_timer.Stop();
 			
 			// Update the UI
-			m_txt_time->SetLabel(S_TXT_TIME_UP);
-			m_txt_section->SetLabel(m_si->name);
+			m_countdown->set_message(S_TXT_TIME_UP);
+			m_time_left_shown = -1;
 			m_btn_pause->SetLabel(S_BTN_START);
+			m_btn_pause->Disable();
 			SetStatusText(S_STATUS_TIME_UP);
 			
 			// Update the timer state
 			m_timer_data.state = TSTATE_START;
 		}
+		else if (m_hidden)
+		{
+			// The deadline timer fired early, so wait for the deadline again
+			start_timer();
+		}
 		else
 			update_txt_time(time_current);
 	}
+
+	// Starts m_timer firing every m_timer_interval milliseconds, or only once at the section deadline if the frame is iconized or hidden
+	void MainFrame::start_timer()
+	{
+		m_hidden = m_iconized || !m_shown;
+
+		bool started;
+		auto time_current = Clock::now();
+		if (m_hidden)
+		{
+			// Round up so that the timer doesn't fire before the deadline, and fire again later if the deadline is too far off for one timer
+			auto ms = chrono::ceil<chrono::milliseconds>(m_timer_data.end - time_current).count();
+			ms = ms < 1 ? 1 : ms > INT_MAX ? INT_MAX : ms;
+			m_timer_due = time_current + chrono::milliseconds(ms);
+			started = m_timer.StartOnce(static_cast<int>(ms));
+		}
+		else
+		{
+			m_timer_due = time_current + chrono::milliseconds(m_timer_interval);
+			started = m_timer.Start(m_timer_interval);
+		}
+		if (!started)
+			on_timer_error();
+	}
 	
 	// Runs when the wxTimer fails to start
 	void MainFrame::on_timer_error()
@@ -262,6 +670,46 @@ namespace pomocom
 		Close(true);
 	}
 	
+	// Switches m_timer between periodic updates and the section deadline after the frame is iconized, restored, hidden, or shown
+	void MainFrame::on_visibility_changed()
+	{
+		if (m_hidden == (m_iconized || !m_shown) || m_timer_data.state != TSTATE_TIMER_RUNNING)
+			return;
+
+		m_timer.Stop();
+		start_timer();
+
+		// Nothing was shown while the frame was hidden, so show the time left now instead of on the next tick
+		if (!m_hidden)
+		{
+			auto time_current = Clock::now();
+			update_txt_time(time_current);
+		}
+	}
+
+	void MainFrame::on_iconize(wxIconizeEvent &e)
+	{
+		m_iconized = e.IsIconized();
+		on_visibility_changed();
+		e.Skip();
+	}
+
+	void MainFrame::on_show(wxShowEvent &e)
+	{
+		m_shown = e.IsShown();
+		on_visibility_changed();
+		e.Skip();
+	}
+
+	// Runs on the GUI thread once m_worker has switched to the section named name that is secs long
+	void MainFrame::on_section_switched(std::string name, int secs)
+	{
+		m_section_name = std::move(name);
+		m_section_secs = secs;
+		m_txt_section->SetLabel(m_section_name);
+		m_btn_pause->Enable();
+	}
+
 	void MainFrame::on_about(wxCommandEvent &e)
 	{
 		m_about_win.Centre();
@@ -278,9 +726,17 @@ namespace pomocom
 	{
 		// Initialize the timer interval based on settings
 		m_timer_interval = 1000 * state.settings.update_interval;
+		m_time_left_shown = -1;
+
+		// The frame isn't shown until after it is created, but the timer can't start before then
+		m_iconized = false;
+		m_shown = true;
+		m_hidden = false;
 		
 		// Get info the current timing section
-		m_si = &state.section_info[state.current_section];
+		const SectionInfo &si = state.sections[state.current_section];
+		m_section_name = state.sections.name(si);
+		m_section_secs = state.current_section_secs;
 		
 		// Frame settings
 		this->SetClientSize(540, 280);
@@ -314,12 +770,27 @@ namespace pomocom
 			SetMenuBar(menu_bar);
 		}
 		
-		// Widget creation and layout
+		// Widget creation
 		auto panel = new wxPanel(this);
-		auto btn_skip = new wxButton(panel, ID_BTN_QUIT, S_BTN_SKIP, wxPoint(0, 24), wxSize(80, 24));
-		m_btn_pause = new wxButton(panel, ID_BTN_PAUSE, S_BTN_START, wxPoint(0, 0), wxSize(80, 24));
-		m_txt_time = new wxStaticText(panel, ID_TXT_TIME, S_TXT_TIME_INIT, wxPoint(90, 0), wxSize(200, 24));
-		m_txt_section = new wxStaticText(panel, ID_TXT_SECTION, S_TXT_SECTION_INIT, wxPoint(90, 25), wxSize(200, 24));
+		auto btn_skip = new wxButton(panel, ID_BTN_QUIT, S_BTN_SKIP, wxDefaultPosition, wxSize(80, 24));
+		m_btn_pause = new wxButton(panel, ID_BTN_PAUSE, S_BTN_START, wxDefaultPosition, wxSize(80, 24));
+		m_txt_section = new wxStaticText(panel, ID_TXT_SECTION, S_TXT_SECTION_INIT);
+		m_countdown = new CountdownCtrl(panel, ID_TXT_TIME);
+
+		// Layout, with the countdown taking up the space left so that it grows with the frame
+		wxBoxSizer *sizer_btn = new wxBoxSizer(wxVERTICAL);
+		sizer_btn->Add(m_btn_pause);
+		sizer_btn->Add(btn_skip);
+
+		wxBoxSizer *sizer_top = new wxBoxSizer(wxHORIZONTAL);
+		sizer_top->Add(sizer_btn);
+		sizer_top->AddSpacer(10);
+		sizer_top->Add(m_txt_section, 0, wxALIGN_CENTRE_VERTICAL);
+
+		wxBoxSizer *sizer_vert = new wxBoxSizer(wxVERTICAL);
+		sizer_vert->Add(sizer_top);
+		sizer_vert->Add(m_countdown, 1, wxEXPAND);
+		panel->SetSizer(sizer_vert);
 		
 		// Status bar
 		CreateStatusBar();
@@ -328,10 +799,21 @@ namespace pomocom
 		// Event binding
 		m_btn_pause->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &MainFrame::on_btn_pause, this);
 		m_timer.Bind(wxEVT_TIMER, &MainFrame::on_timer, this);
+		Bind(wxEVT_ICONIZE, &MainFrame::on_iconize, this);
+		Bind(wxEVT_SHOW, &MainFrame::on_show, this);
 		Bind(wxEVT_MENU, &MainFrame::on_about, this, ID_MENU_ABOUT);
 		Bind(wxEVT_MENU, &MainFrame::on_exit, this, ID_MENU_EXIT);
 	}
 
+	// Stops m_timer and m_worker before any member or widget is destroyed
+	MainFrame::~MainFrame()
+	{
+		// A section switch still running on the worker may call CallAfter() on the frame while it is joined
+		// That only queues an event, and the events queued for the frame are deleted with it without being handled
+		m_timer.Stop();
+		m_worker.stop();
+	}
+
 	AboutWin::AboutWin()
 		: wxDialog(nullptr, wxID_ANY, S_TITLE_ABOUT)
 	{
@@ -393,6 +875,15 @@ namespace pomocom
 
 			auto main_frame = new MainFrame;
 			main_frame->Show();
+			startup_mark("wx init");
+
+			// Pending events, including the first paint, are handled before functions passed to CallAfter()
+			if (startup_profiling())
+				CallAfter([main_frame]
+					{
+						startup_mark("first frame");
+						main_frame->Close(true);
+					});
 			return true;
 		}
 	};
@@ -410,3 +901,11 @@ namespace pomocom
 		wxEntryCleanup();
 	}
 }
+
+#ifdef POMOCOM_MODULE
+// Runs the interface loop when this interface is built as a module (see module.hh)
+extern "C" void pomocom_module_loop()
+{
+	pomocom::interface_wx_loop();
+}
+#endif
@@ -0,0 +1,189 @@
+/*
+ * jitter.cc contains functions for measuring how late timers wake up compared with when they were meant to.
+ */
+
+#include <atomic>
+#include <bit>	// For std::bit_width()
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <type_traits>	// For std::is_same_v
+
+#include "jitter.hh"
+
+namespace pomocom
+{
+	// Values below 2 << JITTER_SUB_BITS us get a bucket each, and every power of 2 above that is split into 1 << JITTER_SUB_BITS buckets
+	constexpr int JITTER_SUB_BITS = 5;
+
+	// Values at or above 1 << JITTER_VALUE_BITS us are counted as 1 << JITTER_VALUE_BITS - 1 us (about 12 days)
+	constexpr int JITTER_VALUE_BITS = 40;
+
+	// # of buckets in a histogram
+	constexpr int JITTER_BUCKETS = (JITTER_VALUE_BITS - JITTER_SUB_BITS + 1) << JITTER_SUB_BITS;
+
+	// Lateness of one event in us, counted by bucket
+	struct JitterHistogram{
+		std::atomic<std::uint64_t> counts[JITTER_BUCKETS];
+		std::atomic<std::uint64_t> total;
+		std::atomic<std::uint64_t> sum;
+		std::atomic<std::uint64_t> max;
+	};
+
+	// A wakeup kept for the trace file
+	struct JitterTraceEntry{
+		std::int64_t intended_ns;
+		std::int64_t actual_ns;
+		JitterEvent ev;
+	};
+
+	// Names of events used in the output
+	static const char *jitter_event_names[JITTER_MAX] = {"timer wakeups", "section ends", "config reloads"};
+
+	// Histogram of each event, zero initialized because it is static
+	static JitterHistogram jitter_histograms[JITTER_MAX];
+
+	// Ring of kept wakeups, or nullptr if they aren't being kept
+	static std::unique_ptr<JitterTraceEntry[]> jitter_trace;
+
+	// # of wakeups ever added to jitter_trace
+	static std::atomic<std::uint64_t> jitter_trace_len;
+
+	// Returns the bucket that us falls in
+	static int jitter_bucket(std::uint64_t us);
+
+	// Returns the smallest value in bucket b
+	static std::uint64_t jitter_bucket_value(int b);
+
+	// Returns the smallest value that at least fraction of the values in h are at or below
+	static std::uint64_t jitter_percentile(const JitterHistogram &h, double fraction);
+
+	// Records that ev was meant to happen at intended and happened at actual
+	void jitter_record(JitterEvent ev, std::chrono::steady_clock::time_point intended, std::chrono::steady_clock::time_point actual)
+	{
+		// The timers used never fire early, but the clock may be read before a deadline when an event is handled late
+		auto late = std::chrono::duration_cast<std::chrono::microseconds>(actual - intended).count();
+		std::uint64_t us = late > 0 ? late : 0;
+		if (us >= std::uint64_t(1) << JITTER_VALUE_BITS)
+			us = (std::uint64_t(1) << JITTER_VALUE_BITS) - 1;
+
+		JitterHistogram &h = jitter_histograms[ev];
+		h.counts[jitter_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+		h.total.fetch_add(1, std::memory_order_relaxed);
+		h.sum.fetch_add(us, std::memory_order_relaxed);
+		for (std::uint64_t max = h.max.load(std::memory_order_relaxed); us > max && !h.max.compare_exchange_weak(max, us, std::memory_order_relaxed);)
+			;
+
+		if (jitter_trace)
+		{
+			std::uint64_t i = jitter_trace_len.fetch_add(1, std::memory_order_relaxed);
+			jitter_trace[i % JITTER_TRACE_MAX] = {intended.time_since_epoch().count(), actual.time_since_epoch().count(), ev};
+		}
+	}
+
+	// Starts keeping wakeups for jitter_write_trace()
+	void jitter_trace_start()
+	{
+		static_assert(std::is_same_v<std::chrono::steady_clock::duration, std::chrono::nanoseconds>, "trace entries hold steady_clock ticks as nanoseconds");
+		if (!jitter_trace)
+			jitter_trace = std::make_unique<JitterTraceEntry[]>(JITTER_TRACE_MAX);
+	}
+
+	// Prints the histograms to file
+	void jitter_print(std::FILE *file)
+	{
+		for (int ev = 0; ev < JITTER_MAX; ++ev)
+		{
+			const JitterHistogram &h = jitter_histograms[ev];
+			std::uint64_t total = h.total.load(std::memory_order_relaxed);
+			std::fprintf(file, "%s: %llu", jitter_event_names[ev], (unsigned long long) total);
+			if (total == 0)
+			{
+				std::fputc('\n', file);
+				continue;
+			}
+
+			std::fprintf(file, ", mean %lluus, p50 %lluus, p90 %lluus, p99 %lluus, p99.9 %lluus, max %lluus\n",
+				(unsigned long long) (h.sum.load(std::memory_order_relaxed) / total),
+				(unsigned long long) jitter_percentile(h, 0.5),
+				(unsigned long long) jitter_percentile(h, 0.9),
+				(unsigned long long) jitter_percentile(h, 0.99),
+				(unsigned long long) jitter_percentile(h, 0.999),
+				(unsigned long long) h.max.load(std::memory_order_relaxed));
+
+			// Print each bucket that was used with a bar scaled to the biggest one
+			std::uint64_t count_max = 0;
+			for (const auto &c : h.counts)
+				if (c.load(std::memory_order_relaxed) > count_max)
+					count_max = c.load(std::memory_order_relaxed);
+			for (int b = 0; b < JITTER_BUCKETS; ++b)
+			{
+				std::uint64_t count = h.counts[b].load(std::memory_order_relaxed);
+				if (count == 0)
+					continue;
+				int bar = count * 40 / count_max;
+				std::fprintf(file, "  >= %10lluus %10llu %.*s\n", (unsigned long long) jitter_bucket_value(b), (unsigned long long) count,
+					bar > 0 ? bar : 1, "########################################");
+			}
+		}
+	}
+
+	// Writes the kept wakeups to the file at *path as Chrome trace event JSON
+	// Returns false on error
+	bool jitter_write_trace(const char *path)
+	{
+		std::FILE *file = std::fopen(path, "w");
+		if (file == nullptr)
+			return false;
+
+		// Each wakeup is a complete event spanning from when it was meant to happen to when it happened
+		std::uint64_t len = jitter_trace_len.load(std::memory_order_relaxed);
+		std::uint64_t first = len > JITTER_TRACE_MAX ? len - JITTER_TRACE_MAX : 0;
+		std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+		for (std::uint64_t i = first; jitter_trace && i < len; ++i)
+		{
+			const JitterTraceEntry &e = jitter_trace[i % JITTER_TRACE_MAX];
+			std::fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				i == first ? "" : ",", jitter_event_names[e.ev], e.ev + 1,
+				e.intended_ns / 1000.0, (e.actual_ns - e.intended_ns) / 1000.0);
+		}
+		std::fputs("\n]}\n", file);
+
+		bool ok = !std::ferror(file);
+		return std::fclose(file) == 0 && ok;
+	}
+
+	// Returns the bucket that us falls in
+	static int jitter_bucket(std::uint64_t us)
+	{
+		// Shift us down until it fits in JITTER_SUB_BITS + 1 bits, then the shift picks the group of buckets and what's left picks the bucket in it
+		int shift = std::bit_width(us) - (JITTER_SUB_BITS + 1);
+		if (shift < 0)
+			shift = 0;
+		return (shift << JITTER_SUB_BITS) + (us >> shift);
+	}
+
+	// Returns the smallest value in bucket b
+	static std::uint64_t jitter_bucket_value(int b)
+	{
+		int shift = (b >> JITTER_SUB_BITS) - 1;
+		if (shift <= 0)
+			return b;
+		return std::uint64_t((b & ((1 << JITTER_SUB_BITS) - 1)) + (1 << JITTER_SUB_BITS)) << shift;
+	}
+
+	// Returns the smallest value that at least fraction of the values in h are at or below
+	static std::uint64_t jitter_percentile(const JitterHistogram &h, double fraction)
+	{
+		std::uint64_t target = h.total.load(std::memory_order_relaxed) * fraction;
+		std::uint64_t seen = 0;
+		for (int b = 0; b < JITTER_BUCKETS; ++b)
+		{
+			seen += h.counts[b].load(std::memory_order_relaxed);
+			if (seen > target)
+				return jitter_bucket_value(b);
+		}
+		return h.max.load(std::memory_order_relaxed);
+	}
+}
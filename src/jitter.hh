@@ -0,0 +1,45 @@
+/*
+ * jitter.hh contains functions for measuring how late timers wake up compared with when they were meant to.
+ *
+ * Each time the reactor's timer or the wxWidgets interface's wxTimer fires, and each time a section ends, the interfaces record the time they meant to wake up and the time they actually woke up. The lateness is counted in a histogram with log-linear buckets like an HDR histogram: values under 64us get a bucket each, and every power of 2 above that is split into 32 buckets, so any lateness up to days is kept to within about 3% in a fixed 9 KiB table. Recording is a few integer ops and relaxed atomic adds, so it is always on. The same histograms also hold how long config reloads take (see reload.hh).
+ *
+ * "pomocom --stats" prints the histograms when pomocom exits. "pomocom --trace (file)" also keeps the last JITTER_TRACE_MAX wakeups and writes them to the file as Chrome trace event JSON, which can be opened in a trace viewer such as Perfetto or chrome://tracing.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>	// For std::FILE
+
+namespace pomocom
+{
+	// Things whose lateness is measured
+	enum JitterEvent{
+		// The reactor's timer or the wxWidgets interface's wxTimer fired
+		JITTER_WAKE,
+
+		// A section ended
+		JITTER_SECTION_END,
+
+		// pomocom.conf or the pomo file was reloaded, measured from when the reload started to when it finished
+		JITTER_RELOAD,
+
+		JITTER_MAX,
+	};
+
+	// Max # of wakeups kept for the trace file, older ones are overwritten
+	constexpr unsigned JITTER_TRACE_MAX = 1 << 16;
+
+	// Records that ev was meant to happen at intended and happened at actual
+	void jitter_record(JitterEvent ev, std::chrono::steady_clock::time_point intended, std::chrono::steady_clock::time_point actual);
+
+	// Starts keeping wakeups for jitter_write_trace()
+	void jitter_trace_start();
+
+	// Prints the histograms to file
+	void jitter_print(std::FILE *file);
+
+	// Writes the kept wakeups to the file at *path as Chrome trace event JSON
+	// Returns false on error
+	bool jitter_write_trace(const char *path);
+}
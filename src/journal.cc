@@ -0,0 +1,317 @@
+/*
+ * journal.cc contains functions for recording the timer state in a journal so that it can be resumed after pomocom exits.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>	// For std::memcpy()
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/file.h>	// For flock()
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hh"	// For pomocom::cache_hash()
+#include "error.hh"
+#include "fileio.hh"
+#include "journal.hh"
+#include "state.hh"
+
+namespace pomocom
+{
+	// First 4 bytes of a journal ("pjnl" in little endian)
+	constexpr std::uint32_t JOURNAL_MAGIC = 0x6c6e6a70;
+
+	// Changed when the layout of the journal changes
+	constexpr std::uint32_t JOURNAL_VERSION = 1;
+
+	// Start of the journal, followed by the name of the pomo file and then the entries
+	struct JournalHeader{
+		std::uint32_t magic;
+		std::uint32_t version;
+
+		// # of chars in the name of the pomo file
+		std::uint32_t name_len;
+
+		std::uint32_t reserved;
+	};
+
+	// Types of journal entries
+	enum JournalEntryType : std::uint32_t{
+		// The section is paused or hasn't started yet
+		JE_PAUSED = 1,
+
+		// The section is being timed
+		JE_RUNNING,
+	};
+
+	// State of the timer after a transition
+	struct JournalEntry{
+		// Checksum of the rest of the entry, used to find entries cut off by a crash
+		std::uint32_t check;
+
+		// Meant to hold a value of type JournalEntryType
+		std::uint32_t type;
+
+		// Index of the section in the pomo file's sections
+		std::uint32_t section;
+
+		// Secs left in the section, only used by JE_PAUSED
+		std::int32_t secs_left;
+
+		// End of the section in nanoseconds since the Unix epoch, only used by JE_RUNNING
+		// Wall clock time is used because the journal is read by a later process, possibly after a reboot
+		std::int64_t deadline_ns;
+	};
+
+	// Path of the journal, empty if no journal is open
+	static std::string journal_file;
+
+	// Header and pomo file name written at the start of the journal
+	static std::string journal_header;
+
+	// Journal opened for appending, or -1 if the next entry should start a new file
+	static int journal_fd = -1;
+
+	// Lock file held while the journal is open for appending, or -1
+	static int journal_lock_fd = -1;
+
+	// # of entries in the journal file
+	static int journal_entries = 0;
+
+	// Last entry written, kept for compaction
+	static JournalEntry journal_last;
+
+	// Returns the checksum of entry e
+	static std::uint32_t journal_check(const JournalEntry &e);
+
+	// Appends entry e to the journal, compacting the journal first if it is time to
+	static void journal_append(JournalEntry &e);
+
+	// Locks the journal so that another pomocom doesn't write it at the same time
+	// Returns false after printing an error if the lock can't be taken
+	static bool journal_lock();
+
+	// Replaces the journal with a new file holding the header and the last entry
+	// Returns false on error
+	static bool journal_compact();
+
+	// Starts a new journal for the pomo file named *name
+	// The old journal is replaced when the first entry is written
+	void journal_open(const char *name)
+	{
+		journal_close();
+		std::string dir = file_state_dir();
+		if (dir.empty())
+			return;
+		journal_file = dir + "/journal";
+
+		JournalHeader header = {};
+		header.magic = JOURNAL_MAGIC;
+		header.version = JOURNAL_VERSION;
+		header.name_len = std::strlen(name);
+		journal_header.assign((const char *) &header, sizeof(header));
+		journal_header += name;
+	}
+
+	// Closes the journal
+	// The journal file is kept so that it can be resumed
+	void journal_close()
+	{
+		if (journal_fd != -1)
+			close(journal_fd);
+		journal_fd = -1;
+		if (journal_lock_fd != -1)
+			close(journal_lock_fd);
+		journal_lock_fd = -1;
+		journal_file.clear();
+	}
+
+	// Appends an entry saying that section # section is being timed and ends at end
+	void journal_write_running(std::size_t section, std::chrono::steady_clock::time_point end)
+	{
+		auto deadline = std::chrono::system_clock::now() + (end - std::chrono::steady_clock::now());
+
+		JournalEntry e = {};
+		e.type = JE_RUNNING;
+		e.section = section;
+		e.deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+		journal_append(e);
+	}
+
+	// Appends an entry saying that section # section is paused or hasn't started yet and has secs_left secs left
+	void journal_write_paused(std::size_t section, int secs_left)
+	{
+		JournalEntry e = {};
+		e.type = JE_PAUSED;
+		e.section = section;
+		e.secs_left = secs_left;
+		journal_append(e);
+	}
+
+	// Reads the last state recorded in the journal into js
+	// Returns false if there is no journal or it has no entries
+	bool journal_read(JournalState &js)
+	{
+		std::string dir = file_state_dir();
+		if (dir.empty())
+			return false;
+		std::string path = dir + "/journal";
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return false;
+
+		// Read the whole journal with one read(2)
+		struct stat st;
+		std::string buf;
+		ssize_t n = -1;
+		if (fstat(fd, &st) == 0 && (std::size_t) st.st_size >= sizeof(JournalHeader))
+		{
+			buf.resize(st.st_size);
+			while ((n = read(fd, buf.data(), buf.size())) == -1 && errno == EINTR);
+		}
+		close(fd);
+		if (n != (ssize_t) buf.size() || buf.empty())
+			return false;
+
+		JournalHeader header;
+		std::memcpy(&header, buf.data(), sizeof(header));
+		if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION || header.name_len > buf.size() - sizeof(header))
+			return false;
+		js.file_name.assign(buf, sizeof(header), header.name_len);
+
+		// Use the last entry that is whole
+		bool found = false;
+		for (std::size_t pos = sizeof(header) + header.name_len; buf.size() - pos >= sizeof(JournalEntry); pos += sizeof(JournalEntry))
+		{
+			JournalEntry e;
+			std::memcpy(&e, buf.data() + pos, sizeof(e));
+			if (e.check != journal_check(e) || (e.type != JE_PAUSED && e.type != JE_RUNNING))
+				break;
+
+			js.section = e.section;
+			js.paused = e.type == JE_PAUSED;
+			js.secs_left = e.secs_left;
+			js.deadline = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(e.deadline_ns)));
+			found = true;
+		}
+		return found;
+	}
+
+	// Returns the checksum of entry e
+	static std::uint32_t journal_check(const JournalEntry &e)
+	{
+		std::string_view rest((const char *) &e + sizeof(e.check), sizeof(e) - sizeof(e.check));
+		return cache_hash(rest);
+	}
+
+	// Appends entry e to the journal, compacting the journal first if it is time to
+	static void journal_append(JournalEntry &e)
+	{
+		if (journal_file.empty())
+			return;
+		e.check = journal_check(e);
+		journal_last = e;
+
+		// The error was printed, and there is no journal until the next journal_open()
+		if (!journal_lock())
+		{
+			journal_close();
+			return;
+		}
+
+		bool ok;
+		if (journal_fd == -1 || journal_entries >= state.settings.journal.compact_after)
+			ok = journal_compact();
+		else
+		{
+			ok = file_write_all(journal_fd, std::string_view((const char *) &e, sizeof(e)));
+			if (ok && state.settings.journal.fsync == JOURNAL_FSYNC_ALWAYS)
+				ok = fdatasync(journal_fd) == 0;
+			++journal_entries;
+		}
+
+		if (!ok)
+		{
+			// Keep timing without a journal instead of printing an error on every transition
+			PERR("failed to write to the journal at \"%s\", the timer can't be resumed", journal_file.c_str());
+			journal_close();
+		}
+	}
+
+	// Locks the journal so that another pomocom doesn't write it at the same time
+	// Returns false after printing an error if the lock can't be taken
+	static bool journal_lock()
+	{
+		if (journal_lock_fd != -1)
+			return true;
+
+		// The journal itself is replaced on every compaction, so lock a file next to it that is never replaced
+		std::string lock_path = journal_file + ".lock";
+		if (!file_make_dirs(journal_file.substr(0, journal_file.rfind('/'))))
+		{
+			PERR("failed to create the directory of the journal at \"%s\", the timer can't be resumed", journal_file.c_str());
+			return false;
+		}
+		int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd == -1)
+		{
+			PERR("failed to open journal lock file \"%s\", the timer can't be resumed", lock_path.c_str());
+			return false;
+		}
+		if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+		{
+			PERR("another pomocom is writing the journal at \"%s\", this timer can't be resumed", journal_file.c_str());
+			close(fd);
+			return false;
+		}
+		journal_lock_fd = fd;
+		return true;
+	}
+
+	// Replaces the journal with a new file holding the header and the last entry
+	// Returns false on error
+	static bool journal_compact()
+	{
+		std::string dir = journal_file.substr(0, journal_file.rfind('/'));
+		if (!file_make_dirs(dir))
+			return false;
+
+		// Write to a temporary file and rename it so that the journal is never left half written
+		std::string tmp_path = journal_file + ".tmp";
+		int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+		if (fd == -1)
+			return false;
+
+		std::string buf = journal_header;
+		buf.append((const char *) &journal_last, sizeof(journal_last));
+		bool sync = state.settings.journal.fsync == JOURNAL_FSYNC_ALWAYS;
+		if (!file_write_all(fd, buf) || (sync && fdatasync(fd) == -1) || rename(tmp_path.c_str(), journal_file.c_str()) == -1)
+		{
+			close(fd);
+			unlink(tmp_path.c_str());
+			return false;
+		}
+
+		// Make sure the rename itself reaches the disk
+		if (sync)
+		{
+			int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dir_fd != -1)
+			{
+				fsync(dir_fd);
+				close(dir_fd);
+			}
+		}
+
+		// Keep appending to the new file
+		if (journal_fd != -1)
+			close(journal_fd);
+		journal_fd = fd;
+		journal_entries = 1;
+		return true;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * journal.hh contains functions for recording the timer state in a journal so that it can be resumed after pomocom exits.
+ *
+ * The journal is a file at $XDG_STATE_HOME/pomocom/journal (or ~/.local/state/pomocom/journal). It starts with a header holding the name of the pomo file, followed by fixed size entries that are appended each time a section starts being timed, is paused, or is switched. Each entry holds the whole state of the timer, so the last entry is all that is needed to resume, and appending one costs a single write(2) (and an fdatasync() if the journal.fsync setting is always).
+ *
+ * After journal.compact_after entries, the journal is compacted into a snapshot: the header and the last entry are written to a new file, which is renamed over the old one so the journal is never left half written. Entries have a checksum, so an entry cut off by a crash is ignored and the entry before it is used.
+ *
+ * The journal is written by the ANSI, ncurses, and wxWidgets interfaces. "pomocom --resume" reads it to continue where the last run left off.
+ *
+ * The wxWidgets interface doesn't take the control socket, so it can run next to another pomocom. Only one of them can write the journal: the first one to write an entry holds an flock() on (journal path).lock until the journal is closed, and the others print an error and run without a journal.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace pomocom
+{
+	// Timer state read from the journal
+	struct JournalState{
+		// Name of the pomo file
+		std::string file_name;
+
+		// Index of the current section
+		std::size_t section;
+
+		// True if the section was paused or hadn't started yet
+		bool paused;
+
+		// Secs left in the section, only used when paused
+		int secs_left;
+
+		// End of the section, only used when not paused
+		std::chrono::system_clock::time_point deadline;
+	};
+
+	// Starts a new journal for the pomo file named *name
+	// The old journal is replaced when the first entry is written
+	void journal_open(const char *name);
+
+	// Closes the journal
+	// The journal file is kept so that it can be resumed
+	void journal_close();
+
+	// Appends an entry saying that section # section is being timed and ends at end
+	void journal_write_running(std::size_t section, std::chrono::steady_clock::time_point end);
+
+	// Appends an entry saying that section # section is paused or hasn't started yet and has secs_left secs left
+	void journal_write_paused(std::size_t section, int secs_left);
+
+	// Reads the last state recorded in the journal into js
+	// Returns false if there is no journal or it has no entries
+	bool journal_read(JournalState &js);
+}
@@ -0,0 +1,404 @@
+/*
+ * pomo.cc contains functions for reading pomo files.
+ */
+
+#include <algorithm>	// For std::upper_bound()
+#include <charconv>	// For std::from_chars()
+#include <cstdio>
+#include <cstring>	// For std::memcpy() and std::strlen()
+#include <ctime>
+#include <string>
+#include <string_view>
+
+#include "cache.hh"
+#include "error.hh"
+#include "fileio.hh"	// For pomocom::file_read_all()
+#include "pomo.hh"
+#include "state.hh"
+
+namespace pomocom
+{
+	// Reads the sections of the pomo file at *path into table where *path is unaltered
+	static void pomo_read_raw(const char *path, SectionTable &table);
+
+	// Sets table to the sections in *text, which holds the contents of the pomo file at *path
+	// Throws EXCEPT_IO after printing the line of the error if *text isn't a valid pomo file
+	static void pomo_parse(std::string_view text, const char *path, SectionTable &table);
+
+	// Replaces the three sections of a classic pomo file in table with a full cycle of work sections, breaks, and a long break
+	static void pomo_expand_classic(SectionTable &table);
+
+	// Replaces data with the sections in table
+	// Stored as the # of sections, the sections, then the strings
+	static void pomo_encode(const SectionTable &table, std::string &data);
+
+	// Sets table to the sections in data written by pomo_encode()
+	// Returns false if data is malformed
+	static bool pomo_decode(SectionTable &table, std::string_view data);
+
+	// Returns the index of the first section of kind kind, or 0 if there isn't one
+	std::size_t SectionTable::find_kind(Section kind) const
+	{
+		for (std::size_t i = 0; i < sections.size(); ++i)
+		{
+			if (sections[i].kind == kind)
+				return i;
+		}
+		return 0;
+	}
+
+	// Returns the offset of *str in strings, adding it if it isn't stored yet
+	std::uint32_t SectionTable::intern(std::string_view str)
+	{
+		// Any match followed by a null terminator is a copy of *str, including the end of a longer string
+		for (std::size_t pos = strings.find(str); pos != std::string::npos; pos = strings.find(str, pos + 1))
+		{
+			if (pos + str.size() < strings.size() && strings[pos + str.size()] == '\0')
+				return pos;
+		}
+
+		std::uint32_t offset = strings.size();
+		strings += str;
+		strings += '\0';
+		return offset;
+	}
+
+	// Builds starts from the durations of the sections
+	// Must be called again after the durations are changed
+	void SectionTable::index_starts()
+	{
+		starts.resize(sections.size() + 1);
+		std::int64_t start = 0;
+		for (std::size_t i = 0; i < sections.size(); ++i)
+		{
+			starts[i] = start;
+			start += sections[i].secs;
+		}
+		starts.back() = start;
+	}
+
+	// Finds the section that is running secs after the start of the first section, wrapping around at the end of the cycle
+	// Sets index to the index of the section and secs_left to the secs left in it
+	void SectionTable::seek(std::int64_t secs, std::size_t &index, int &secs_left) const
+	{
+		std::int64_t cycle = starts.back();
+		secs %= cycle;
+		if (secs < 0)
+			secs += cycle;
+
+		// The section running is the last one that starts at or before secs
+		auto it = std::upper_bound(starts.begin(), starts.end() - 1, secs);
+		index = it - starts.begin() - 1;
+		secs_left = starts[index + 1] - secs;
+	}
+
+	// Reads a time of day written as HH:MM or HH:MM:SS from *str into secs
+	// Returns false if *str isn't a valid time of day
+	bool pomo_parse_time_of_day(std::string_view str, int &secs)
+	{
+		int parts[3] = {0, 0, 0};
+		int n = 0;
+		const char *p = str.data();
+		const char *end = p + str.size();
+		for (; n < 3; ++n)
+		{
+			auto result = std::from_chars(p, end, parts[n]);
+			if (result.ec != std::errc() || result.ptr - p > 2)
+				return false;
+			p = result.ptr;
+			if (p == end || *p != ':')
+				break;
+			++p;
+		}
+		if (p != end || n == 0 || n == 3)
+			return false;
+		if (parts[0] < 0 || parts[0] > 23 || parts[1] < 0 || parts[1] > 59 || parts[2] < 0 || parts[2] > 59)
+			return false;
+		secs = parts[0] * 3600 + parts[1] * 60 + parts[2];
+		return true;
+	}
+
+	// Sets the length of every section of table to the secs in secs[] for its kind
+	// secs holds SECTION_MAX lengths
+	void pomo_set_kind_secs(SectionTable &table, const int *secs)
+	{
+		for (SectionInfo &si : table.sections)
+			si.secs = secs[si.kind];
+		table.index_starts();
+	}
+
+	// Finds the section of table that is running now if the first section started at start_secs secs after midnight
+	// If that time hasn't come yet today, the cycle is taken to have started at that time yesterday
+	// Sets index to the index of the section and secs_left to the secs left in it
+	void pomo_seek_time_of_day(const SectionTable &table, int start_secs, std::size_t &index, int &secs_left)
+	{
+		std::time_t now = std::time(nullptr);
+		std::tm local;
+		localtime_r(&now, &local);
+		std::int64_t elapsed = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec - start_secs;
+		if (elapsed < 0)
+			elapsed += 24 * 60 * 60;
+		table.seek(elapsed, index, secs_left);
+	}
+
+	// Returns the path of the pomo file named *name
+	// If *name starts with "/", it is an absolute path, if it starts with "./", the file is searched for relative to the working directory, and otherwise it is searched for in the path.section directory
+	// ".pomo" is appended to *name to get the file path
+	std::string pomo_path(const char *name)
+	{
+		std::string path;
+		if (name[0] == '/')
+		{
+			// Path is absolute, like the paths that "pomocom ctl load" sends
+			path += name;
+		}
+		else if (std::strlen(name) >= 2 && name[0] == '.' && name[1] == '/')
+		{
+			// Path is relative
+			path += (name + 2);
+		}
+		else
+		{
+			// Name is of a pomo file in path.section
+			path += state.settings.path.section;
+			path += name;
+		}
+		path += ".pomo";
+		return path;
+	}
+
+	// Reads the sections of the pomo file named *name into table
+	// A pomo file with three sections and no section kinds is read as a classic pomo file, and its sections are repeated to make a cycle of breaks_until_long_reset breaks followed by a long break
+	// The file is found with pomo_path()
+	// The sections are cached (see cache.hh), and later calls load the cache instead if the pomo file hasn't changed
+	void pomo_read(const char *name, SectionTable &table)
+	{
+		std::string alt_path = pomo_path(name);
+
+		// Load the sections from the cache if the pomo file hasn't changed since it was cached
+		// Commands starting with '+' depend on the path.bin setting and classic pomo files depend on breaks_until_long_reset, so they are part of the key
+		// Stamping it reads the whole file, which is parsed if the cache is out of date
+		CacheStamp stamp;
+		std::string text;
+		bool stamped = cache_stamp(alt_path.c_str(), stamp, text);
+		std::uint64_t key = cache_hash_number(sizeof(SectionInfo));
+		key = cache_hash_number(state.settings.breaks_until_long_reset, key);
+		key = cache_hash(state.settings.path.bin, key);
+		key = cache_hash(alt_path, key);
+
+		char cache_name[32];
+		std::snprintf(cache_name, sizeof(cache_name), "pomo-%016llx.cache", (unsigned long long) cache_hash(alt_path));
+
+		std::string data;
+		if (!stamped || !cache_load(cache_name, stamp, key, data) || !pomo_decode(table, data))
+		{
+			// Actually loading the section data with the altered path
+			// If the file couldn't be stamped, reading it again prints the error
+			if (!stamped)
+				pomo_read_raw(alt_path.c_str(), table);
+			else
+			{
+				pomo_parse(text, alt_path.c_str(), table);
+				pomo_encode(table, data);
+				cache_store(cache_name, stamp, key, data);
+			}
+		}
+
+		// The starts take one pass to build, so they aren't cached
+		table.index_starts();
+	}
+
+	// Reads the sections of the pomo file at *path into table where *path is unaltered
+	static void pomo_read_raw(const char *path, SectionTable &table)
+	{
+		std::string text;
+		file_read_all(path, text);
+		pomo_parse(text, path, table);
+	}
+
+	// Sets table to the sections in *text, which holds the contents of the pomo file at *path
+	// Throws EXCEPT_IO after printing the line of the error if *text isn't a valid pomo file
+	static void pomo_parse(std::string_view text, const char *path, SectionTable &table)
+	{
+		table.strings.clear();
+		table.sections.clear();
+
+		// True if any section was given a kind
+		bool kinds_given = false;
+
+		std::size_t pos = 0;
+		int line_number = 0;
+
+		// Sets line to the next line of text and returns false at the end of the text
+		auto next_line = [&text, &pos, &line_number](std::string_view &line)
+			{
+				if (pos >= text.size())
+					return false;
+				std::size_t end = text.find('\n', pos);
+				if (end == std::string_view::npos)
+					end = text.size();
+				line = text.substr(pos, end - pos);
+				pos = end + 1;
+				++line_number;
+				return true;
+			};
+
+		auto is_blank = [](std::string_view line)
+			{
+				return line.find_first_not_of(" \t\r") == std::string_view::npos;
+			};
+
+		std::string_view line;
+		for (;;)
+		{
+			// Sections are separated by blank lines
+			bool found = false;
+			while ((found = next_line(line)) && is_blank(line));
+			if (!found)
+				break;
+
+			SectionInfo si;
+			si.name = table.intern(line);
+
+			// Read in section command
+			if (!next_line(line))
+			{
+				PERR("%s:%d: section \"%.*s\" has no command line", path, line_number, (int) line.size(), line.data());
+				throw EXCEPT_IO;
+			}
+			if (!line.empty() && line[0] == '+')
+			{
+				// The program run in the command is in pomocom's bin directory
+				std::string buf(state.settings.path.bin);
+				buf += line.substr(1);
+				si.cmd = table.intern(buf);
+			}
+			else
+			{
+				// The program run in the command is in the user's $PATH
+				si.cmd = table.intern(line);
+			}
+
+			// Read in section duration and kind
+			if (!next_line(line))
+			{
+				PERR("%s:%d: section has no duration line", path, line_number);
+				throw EXCEPT_IO;
+			}
+			std::size_t start = line.find_first_not_of(" \t");
+			std::size_t end = line.find_last_not_of(" \t\r");
+			line = start == std::string_view::npos ? std::string_view() : line.substr(start, end - start + 1);
+
+			int minutes = 0, seconds = 0;
+			const char *p = line.data();
+			const char *line_end = p + line.size();
+			auto result = std::from_chars(p, line_end, minutes);
+			if (result.ec == std::errc() && result.ptr != line_end && *result.ptr == 'm')
+				result = std::from_chars(result.ptr + 1, line_end, seconds);
+			if (result.ec != std::errc() || result.ptr == line_end || *result.ptr != 's')
+			{
+				PERR("%s:%d: invalid section duration \"%.*s\"", path, line_number, (int) line.size(), line.data());
+				throw EXCEPT_IO;
+			}
+			si.secs = minutes * 60 + seconds;
+			if (si.secs <= 0)
+			{
+				PERR("%s:%d: section duration must be positive", path, line_number);
+				throw EXCEPT_IO;
+			}
+
+			// The kind is an optional word after the duration
+			std::string_view kind = line.substr(result.ptr + 1 - line.data());
+			std::size_t kind_start = kind.find_first_not_of(" \t");
+			kind = kind_start == std::string_view::npos ? std::string_view() : kind.substr(kind_start);
+			if (kind.empty() || kind == "work")
+				si.kind = SECTION_WORK;
+			else if (kind == "break")
+				si.kind = SECTION_BREAK;
+			else if (kind == "long")
+				si.kind = SECTION_BREAK_LONG;
+			else
+			{
+				PERR("%s:%d: unknown section kind \"%.*s\"", path, line_number, (int) kind.size(), kind.data());
+				throw EXCEPT_IO;
+			}
+			kinds_given |= !kind.empty();
+
+			table.sections.push_back(si);
+		}
+
+		if (table.sections.empty())
+		{
+			PERR("pomo file \"%s\" has no sections", path);
+			throw EXCEPT_IO;
+		}
+
+		// Pomo files with three sections and no kinds are the classic work, break, and long break
+		if (table.sections.size() == 3 && !kinds_given)
+			pomo_expand_classic(table);
+	}
+
+	// Replaces the three sections of a classic pomo file in table with a full cycle of work sections, breaks, and a long break
+	static void pomo_expand_classic(SectionTable &table)
+	{
+		SectionInfo work = table.sections[0];
+		SectionInfo brk = table.sections[1];
+		SectionInfo brk_long = table.sections[2];
+		brk.kind = SECTION_BREAK;
+		brk_long.kind = SECTION_BREAK_LONG;
+
+		// breaks_until_long_reset short breaks come before the long break, and a negative value means there is no long break
+		int breaks = state.settings.breaks_until_long_reset;
+		table.sections.clear();
+		for (int i = 0; i < breaks || (breaks < 0 && i == 0); ++i)
+		{
+			table.sections.push_back(work);
+			table.sections.push_back(brk);
+		}
+		if (breaks >= 0)
+		{
+			table.sections.push_back(work);
+			table.sections.push_back(brk_long);
+		}
+	}
+
+	// Replaces data with the sections in table
+	// Stored as the # of sections, the sections, then the strings
+	static void pomo_encode(const SectionTable &table, std::string &data)
+	{
+		std::uint32_t count = table.sections.size();
+		data.assign((const char *) &count, sizeof(count));
+		data.append((const char *) table.sections.data(), count * sizeof(SectionInfo));
+		data += table.strings;
+	}
+
+	// Sets table to the sections in data written by pomo_encode()
+	// Returns false if data is malformed
+	static bool pomo_decode(SectionTable &table, std::string_view data)
+	{
+		std::uint32_t count;
+		if (data.size() < sizeof(count))
+			return false;
+		std::memcpy(&count, data.data(), sizeof(count));
+		data.remove_prefix(sizeof(count));
+		if (count == 0 || data.size() / sizeof(SectionInfo) < count)
+			return false;
+
+		std::string_view strings = data.substr(count * sizeof(SectionInfo));
+		if (strings.empty() || strings.back() != '\0')
+			return false;
+
+		table.sections.resize(count);
+		std::memcpy(table.sections.data(), data.data(), count * sizeof(SectionInfo));
+		for (const SectionInfo &si : table.sections)
+		{
+			if (si.name >= strings.size() || si.cmd >= strings.size() || si.secs <= 0 || si.kind < 0 || si.kind >= SECTION_MAX)
+			{
+				table.sections.clear();
+				return false;
+			}
+		}
+		table.strings.assign(strings);
+		return true;
+	}
+}
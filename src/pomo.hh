@@ -0,0 +1,41 @@
+/*
+ * pomo.hh contains functions for reading pomo files.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "pomocom.hh"	// For SectionTable
+
+namespace pomocom
+{
+	// Name of the pomo file read when none is specified
+	constexpr const char *POMO_FILE_DEFAULT = "standard";
+
+	// Returns the path of the pomo file named *name
+	// If *name starts with "/", it is an absolute path, if it starts with "./", the file is searched for relative to the working directory, and otherwise it is searched for in the path.section directory
+	// ".pomo" is appended to *name to get the file path
+	std::string pomo_path(const char *name);
+
+	// Reads the sections of the pomo file named *name into table
+	// A pomo file with three sections and no section kinds is read as a classic pomo file, and its sections are repeated to make a cycle of breaks_until_long_reset breaks followed by a long break
+	// The file is found with pomo_path()
+	// The sections are cached (see cache.hh), and later calls load the cache instead if the pomo file hasn't changed
+	void pomo_read(const char *name, SectionTable &table);
+
+	// Sets the length of every section of table to the secs in secs[] for its kind
+	// secs holds SECTION_MAX lengths
+	void pomo_set_kind_secs(SectionTable &table, const int *secs);
+
+	// Reads a time of day written as HH:MM or HH:MM:SS from *str into secs
+	// Returns false if *str isn't a valid time of day
+	bool pomo_parse_time_of_day(std::string_view str, int &secs);
+
+	// Finds the section of table that is running now if the first section started at start_secs secs after midnight
+	// If that time hasn't come yet today, the cycle is taken to have started at that time yesterday
+	// Sets index to the index of the section and secs_left to the secs left in it
+	void pomo_seek_time_of_day(const SectionTable &table, int start_secs, std::size_t &index, int &secs_left);
+}
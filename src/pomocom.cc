@@ -1,32 +1,65 @@
 /*
- * pomocom.cc contains main() and pomo file reading code.
+ * pomocom.cc contains main().
  */
 
-#include <cstring>	// For std::strcpy() and std::strlen()
+#include <chrono>
+#include <cstdio>	// For stderr
+#include <cstring>	// For std::strcmp()
 #include <iostream>
 #include <sstream>
 
+#include <unistd.h>	// For close()
+
 #include "error.hh"
-#include "fileio.hh"
+#include "history.hh"
+#include "jitter.hh"
 #include "interface/all.hh"
+#include "interface/base.hh"	// For pomocom::base_publish_paused()
+#include "interface/control.hh"
+#include "interface/module.hh"
+#include "journal.hh"
+#include "pomo.hh"
 #include "pomocom.hh"
+#include "reload.hh"
+#include "startup.hh"
 #include "state.hh"
+#include "status_page.hh"
 #include "terminal_title.hh"
 
 namespace pomocom
 {
-	// Reads sections from the file at *path where *path is altered
-	static void read_sections(const char *path);
+	// Reads the sections of the pomo file named *name into the global state
+	static void read_sections(const char *name);
+
+	// Reads the pomo file and current section recorded in the journal into the global state
+	static void resume_sections();
+
+	// True if the timer lateness histograms are printed on exit
+	static bool print_stats;
 
-	// Reads sections from the file at *path where *path is unaltered
-	static void read_sections_raw(const char *path);
+	// Name of the file that timer wakeups are written to on exit, or nullptr if they aren't
+	static const char *trace_file_name;
 
-	static constexpr const char *DEFAULT_POMO_FILE = "standard";
+	// # of cycles to run the pomo file through with --simulate, or 0 to time sections normally
+	static long simulate_cycles;
+
+	// Name of the pomo file read from the journal
+	// state.file_name points to this after the timer is resumed
+	static std::string resumed_file_name;
 }
 
 int main(int argc, char **argv)
 {
 	using namespace pomocom;
+	startup_mark("main");
+
+	// "pomocom ctl (request)" sends a request to a running pomocom instead of starting one
+	if (argc > 1 && std::strcmp(argv[1], "ctl") == 0)
+		return control_client(argc - 2, argv + 2);
+
+	// "pomocom stats" prints totals from the history instead of starting a timer
+	if (argc > 1 && std::strcmp(argv[1], "stats") == 0)
+		return history_stats(argc - 2, argv + 2);
 
 	int exit_code = EXIT_SUCCESS;
 
@@ -34,15 +67,24 @@ int main(int argc, char **argv)
 	{
 		// Read pomocom.conf
 		settings_read(state.settings);
+		startup_mark("settings_read");
 
 		// Set state values
-		state.current_section = SECTION_WORK;
-		state.breaks_until_long = state.settings.breaks_until_long_reset;
 		state.file_name = nullptr;
+		state.first_section = FIRST_SECTION_DEFAULT;
+
+		// Set by --resume to continue from the journal instead of starting a pomo file
+		bool resume = false;
+
+		// Kind of section to start with
+		Section first_section = SECTION_WORK;
+
+		// Secs after midnight that the first section started at, or -1 to start at the beginning of the first section
+		int start_time = -1;
 
 		// Read command line args
 		if (argc == 1)
-			read_sections(DEFAULT_POMO_FILE);
+			read_sections(POMO_FILE_DEFAULT);
 		else if (argc > 1)
 		{
 			bool pomo_file_was_specified = false;
@@ -60,6 +102,57 @@ int main(int argc, char **argv)
 						// Assume the argument contains a setting name after the "--"
 						char *setting_name = arg + 2;
 
+						// Long arguments that don't take a value
+						if (std::strcmp(setting_name, "daemon") == 0)
+						{
+							// Shorthand for --interface daemon
+							state.settings.interface = INTERFACE_DAEMON;
+							continue;
+						}
+						if (std::strcmp(setting_name, "resume") == 0)
+						{
+							// Continue the timer recorded in the journal
+							resume = true;
+							continue;
+						}
+						if (std::strcmp(setting_name, "profile-startup") == 0)
+						{
+							// Quit after the first frame and print how long each startup phase took
+							startup_profile_enable();
+							continue;
+						}
+						if (std::strcmp(setting_name, "stats") == 0)
+						{
+							// Print the timer lateness histograms on exit
+							print_stats = true;
+							continue;
+						}
+						if (std::strcmp(setting_name, "simulate") == 0)
+						{
+							// Run the pomo file through cycles on a virtual clock as fast as possible
+							// usage: --simulate (cycles)
+							if (i + 1 == argc || (simulate_cycles = std::atol(argv[i + 1])) <= 0)
+							{
+								PERR("\"--simulate\" must be followed by a # of cycles");
+								throw EXCEPT_BAD_SETTING;
+							}
+							++i;
+							continue;
+						}
+						if (std::strcmp(setting_name, "trace") == 0)
+						{
+							// Write the timer wakeups to a trace file on exit
+							// usage: --trace (file)
+							if (i + 1 == argc)
+							{
+								PERR("\"--trace\" must be followed by a file name");
+								throw EXCEPT_BAD_SETTING;
+							}
+							trace_file_name = argv[++i];
+							jitter_trace_start();
+							continue;
+						}
+
 						// The next argument should be the setting value
 
 						if (i + 1 == argc)
@@ -72,16 +165,10 @@ int main(int argc, char **argv)
 						// There is a next argument, so we can increment i without going out of bounds
 						++i;
 						char *setting_value = argv[i];
-						try{ setting_set(state.settings, setting_name, setting_value); }
-						catch (Exception &e)
-						{
-							
-							if (e != EXCEPT_IO)
-							{
-								// A memory allocation failed, so we can't handle it
-								throw e;
-							}
-						}
+						// Keep the setting when pomocom.conf is reloaded
+						// An unknown setting or invalid value was already reported, so it's skipped
+						if (setting_set(state.settings, setting_name, setting_value))
+							reload_add_override(setting_name, setting_value);
 					}
 					else
 					{
@@ -90,11 +177,21 @@ int main(int argc, char **argv)
 						{
 						case 'b':
 							// Start with short break section
-							state.current_section = SECTION_BREAK;
+							first_section = SECTION_BREAK;
 							break;
 						case 'B':
 							// Start with long break section
-							state.current_section = SECTION_BREAK_LONG;
+							first_section = SECTION_BREAK_LONG;
+							break;
+						case 's':
+							// Start partway through the pomo file as if its first section started at a time of day
+							// usage: -s (HH:MM)
+							if (i + 1 >= argc || !pomo_parse_time_of_day(argv[i + 1], start_time))
+							{
+								PERR("\"-s\" must be followed by a time of day (HH:MM or HH:MM:SS)");
+								throw EXCEPT_BAD_SETTING;
+							}
+							++i;
 							break;
 						case 'q':
 							// Quick pomo file setup
@@ -108,11 +205,15 @@ int main(int argc, char **argv)
 
 								// Use the names and commands from the default pomo file
 								pomo_file_was_specified = true;
-								read_sections(DEFAULT_POMO_FILE);
-
-								// Overwrite the length of each section based on the args after -q
-								for (SectionInfo &si : state.section_info)
-									si.secs = std::atoi(argv[++i]) * 60;
+								read_sections(POMO_FILE_DEFAULT);
+
+								// Overwrite the length of each kind of section based on the args after -q
+								// The lengths are kept when the pomo file is reloaded
+								int secs[SECTION_MAX];
+								for (int &s : secs)
+									s = std::atoi(argv[++i]) * 60;
+								pomo_set_kind_secs(state.sections, secs);
+								reload_set_kind_secs(secs);
 							}
 							break;
 						default:
@@ -125,17 +226,19 @@ int main(int argc, char **argv)
 				{
 					// The argument doesn't start with "-"
 					// Assume the argument is the name of a pomo file
+					// It replaces the sections from an earlier -q, along with their lengths
 					pomo_file_was_specified = true;
 					read_sections(arg);
+					reload_set_kind_secs(nullptr);
 				}
 			}
 
-			if (!pomo_file_was_specified)
-				read_sections(DEFAULT_POMO_FILE);
+			if (!pomo_file_was_specified && !resume)
+				read_sections(POMO_FILE_DEFAULT);
 		}
 
 		// Check for valid card data
-		for (SectionInfo &s : state.section_info)
+		for (const SectionInfo &s : state.sections.sections)
 		{
 			if (s.secs <= 0)
 			{
@@ -144,30 +247,101 @@ int main(int argc, char **argv)
 			}
 		}
 
-		if ((state.settings.interface == INTERFACE_ANSI ||
-		     state.settings.interface == INTERFACE_NCURSES) &&
-		    state.settings.set_terminal_title)
+		// Start with the first section of the kind asked for, or with the section running now if a start time was given
+		if (resume)
+			resume_sections();
+		else if (start_time >= 0)
+			pomo_seek_time_of_day(state.sections, start_time, state.current_section, state.current_section_secs);
+		else
 		{
-			std::stringstream title;
-			title << "pomocom - " << state.file_name;
-			set_terminal_title(title.view());
+			state.current_section = state.sections.find_kind(first_section);
+			state.current_section_secs = state.sections[state.current_section].secs;
 		}
 
-		// Use the specified interface
-		switch (state.settings.interface)
+		startup_mark("read_sections");
+
+		// A simulation runs on its own, without a control socket or anything that outlives it
+		if (simulate_cycles > 0)
+			interface_simulate_loop(simulate_cycles);
+		else
 		{
-		case INTERFACE_ANSI:
-			interface_ansi_loop();
-			break;
-		case INTERFACE_NCURSES:
-			interface_ncurses_loop();
-			break;
-		case INTERFACE_WX:
-			interface_wx_loop();
-			break;
-		default:
-			PERR("unknown interface");
-			throw EXCEPT_BAD_SETTING;
+			// Only one pomocom can own the control socket
+			// If one is already running, show its countdown instead of starting another timer
+			bool attached = false;
+			if (state.settings.interface != INTERFACE_WX)
+			{
+				int fd = control_connect();
+				if (fd != -1)
+				{
+					if (state.settings.interface == INTERFACE_DAEMON)
+					{
+						close(fd);
+						PERR("pomocom is already running, use \"pomocom ctl\" to control it");
+						throw EXCEPT_GENERIC;
+					}
+					control_attach(fd);
+					close(fd);
+					attached = true;
+				}
+			}
+			startup_mark("control_connect");
+
+			if (!attached)
+			{
+				if ((state.settings.interface == INTERFACE_ANSI ||
+				     state.settings.interface == INTERFACE_NCURSES) &&
+				    state.settings.set_terminal_title)
+				{
+					std::stringstream title;
+					title << "pomocom - " << state.file_name;
+					set_terminal_title(title.view());
+					startup_mark("set_terminal_title");
+				}
+
+				// The daemon runs many sessions, so it doesn't have one status to show
+				if (state.settings.interface != INTERFACE_DAEMON)
+				{
+					status_page_open();
+					journal_open(state.file_name);
+					history_open(state.file_name);
+					base_publish_paused(state.current_section_secs);
+					startup_mark("status page, journal");
+				}
+
+				// Use the specified interface
+				switch (state.settings.interface)
+				{
+				case INTERFACE_ANSI:
+					interface_ansi_loop();
+					break;
+				case INTERFACE_NCURSES:
+#if defined(POMOCOM_NCURSES_MODULE)
+					module_loop("ncurses");
+#elif defined(POMOCOM_NCURSES_STATIC)
+					interface_ncurses_loop();
+#else
+					PERR("pomocom was built without the ncurses interface");
+					throw EXCEPT_BAD_SETTING;
+#endif
+					break;
+				case INTERFACE_WX:
+#if defined(POMOCOM_WX_MODULE)
+					module_loop("wx");
+#elif defined(POMOCOM_WX_STATIC)
+					interface_wx_loop();
+#else
+					PERR("pomocom was built without the wxWidgets interface");
+					throw EXCEPT_BAD_SETTING;
+#endif
+					break;
+				case INTERFACE_DAEMON:
+					interface_daemon_loop();
+					break;
+				default:
+					PERR("unknown interface");
+					throw EXCEPT_BAD_SETTING;
+				}
+			}
 		}
 	}
 	catch (...)
@@ -177,10 +351,20 @@ int main(int argc, char **argv)
 	}
 
 	// Cleanup and exit
-	settings_free_strings(state.settings);
+	status_page_close();
+	journal_close();
+	history_close();
+	if (print_stats)
+		jitter_print(stderr);
+	if (trace_file_name != nullptr && !jitter_write_trace(trace_file_name))
+		PERR("failed to write trace file \"%s\"", trace_file_name);
+	if (startup_profiling())
+		startup_print(stderr);
 
 	// Bye bye
-	if (exit_code == EXIT_SUCCESS)
+	// The daemon's stdout is only used for its responses
+	// The simulation's stdout is only used for its sections
+	if (exit_code == EXIT_SUCCESS && state.settings.interface != INTERFACE_DAEMON && simulate_cycles == 0)
 		std::cout << "Hey thanks for using pomocom.\n";
 
 	return exit_code;
@@ -188,90 +372,53 @@ int main(int argc, char **argv)
 
 namespace pomocom
 {
-	// Reads sections from the file at *path where *path is unaltered
-	static void read_sections_raw(const char *path)
+	// Reads the sections of the pomo file named *name into the global state
+	static void read_sections(const char *name)
 	{
-		SmartFilePtr sfp(path, "r");
-		auto &fp = sfp.m_fp;
+		state.file_name = name;
+		pomo_read(name, state.sections);
+	}
 
-		// Get section data
-		for (SectionInfo &s : state.section_info)
+	// Reads the pomo file and current section recorded in the journal into the global state
+	static void resume_sections()
+	{
+		JournalState js;
+		if (!journal_read(js))
 		{
-			// Read in section name
-			try { spdl_readstr(s.name, SECTION_INFO_NAME_LEN, '\n', fp); }
-			catch (Exception &e)
-			{
-				if (e == EXCEPT_OVERRUN)
-				{
-					PERR("max chars read for section info name (over %d)", SECTION_INFO_NAME_LEN - 1);
-					throw e;
-				}
-			}
-
-			// Read in section command
-			try
-			{
-				int c = fgetc(fp);
-				if (c == '+')
-				{
-					// The program run in the command is in pomocom's bin directory
-
-					// Used to construct the proper path to the script
-					std::string buf(state.settings.path.bin);
-
-					// Add the rest of the command name to buf
-					// The max # of chars to read here is shortened because s.cmd needs to contain the path to the script directory
-					spdl_readstr(s.cmd, SECTION_INFO_CMD_LEN - buf.size(), '\n', fp);
-					buf += s.cmd;
-
-					// Copy the final command from buf to s.cmd
-					std::strcpy(s.cmd, buf.c_str());
-				}
-				else
-				{
-					// The program run in the command is in the user's $PATH
-					ungetc(c, fp);
-					spdl_readstr(s.cmd, SECTION_INFO_CMD_LEN, '\n', fp);
-				}
-			}
-			catch (Exception &e)
-			{
-				if (e == EXCEPT_OVERRUN)
-				{
-					PERR("max chars read for section info command (over %d)", SECTION_INFO_CMD_LEN - 1);
-					throw e;
-				}
-			}
+			PERR("there is no timer to resume");
+			throw EXCEPT_GENERIC;
+		}
 
-			// Read in section duration
-			int minutes, seconds;
-			if (std::fscanf(fp, "%dm%ds\n", &minutes, &seconds) != 2)
-				throw EXCEPT_IO;
-			s.secs = minutes * 60 + seconds;
+		resumed_file_name = std::move(js.file_name);
+		read_sections(resumed_file_name.c_str());
+		if (js.section >= state.sections.size())
+		{
+			PERR("the pomo file \"%s\" has changed since the timer was stopped", state.file_name);
+			throw EXCEPT_GENERIC;
 		}
-	}
 
-	// Reads sections from the file at *path where *path is altered
-	static void read_sections(const char *path)
-	{
-		state.file_name = path;
+		if (js.paused)
+		{
+			state.current_section = js.section;
+			state.current_section_secs = js.secs_left;
+			state.first_section = FIRST_SECTION_PAUSED;
+			return;
+		}
 
-		// Altering the path
-		std::string alt_path("");
-		if (std::strlen(path) >= 2 && path[0] == '.' && path[1] == '/')
+		// The section kept going while pomocom wasn't running
+		auto ns_left = std::chrono::duration_cast<std::chrono::nanoseconds>(js.deadline - std::chrono::system_clock::now()).count();
+		if (ns_left > 0)
 		{
-			// Path is relative
-			alt_path += (path + 2);
+			state.current_section = js.section;
+			state.current_section_secs = (ns_left + 999999999) / 1000000000;
 		}
 		else
 		{
-			// Path is absolute
-			alt_path += state.settings.path.section;
-			alt_path += path;
+			// Skip the sections that would have ended by now
+			// starts[section + 1] is where the section ended, and seek() wraps around past the last section
+			std::int64_t end = state.sections.starts[js.section + 1];
+			state.sections.seek(end - ns_left / 1000000000, state.current_section, state.current_section_secs);
 		}
-		alt_path += ".pomo";
-
-		// Actually loading the section data with the altered path
-		read_sections_raw(alt_path.c_str());
+		state.first_section = FIRST_SECTION_RUNNING;
 	}
 }
@@ -1,17 +1,25 @@
 /*
  * pomocom.hh contains section types.
+ *
+ * The sections read from a pomo file are stored in a SectionTable, which is a list of sections that are run in order, with the first section following the last. The names and commands of the sections are stored once each in one string, and sections refer to them by offset, so a section costs 16 bytes plus the length of any strings that no other section uses.
+ *
+ * A SectionTable also keeps the start of each section in secs from the start of the first section. seek() uses these prefix sums to find the section running at any point of the cycle with a binary search, so a day plan with hundreds of sections can be picked up at the current time of day without walking through it.
  */
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace pomocom
 {
 	#define	POMOCOM_VERSION	"0.0.0"
-	constexpr int SECTION_INFO_NAME_LEN = 100;
-	constexpr int SECTION_INFO_CMD_LEN = 100;
 
-	// Timing sections
-	enum Section{
+	// Kinds of timing sections
+	enum Section : std::int32_t{
 		SECTION_WORK,
 		SECTION_BREAK,
 		SECTION_BREAK_LONG,
@@ -20,8 +28,50 @@ namespace pomocom
 
 	// Info on each timing section
 	struct SectionInfo{
-		char name[SECTION_INFO_NAME_LEN];
-		char cmd[SECTION_INFO_CMD_LEN];
-		int secs;
+		// Offsets of the null terminated name and command in SectionTable::strings
+		std::uint32_t name;
+		std::uint32_t cmd;
+
+		std::int32_t secs;
+		Section kind;
+	};
+
+	// Sections read from a pomo file
+	struct SectionTable{
+		// Null terminated names and commands of the sections
+		std::string strings;
+
+		// Sections in the order they are run
+		std::vector<SectionInfo> sections;
+
+		// Secs from the start of the first section to the start of each section, followed by the length of the whole cycle
+		std::vector<std::int64_t> starts;
+
+		const SectionInfo &operator[](std::size_t i) const { return sections[i]; }
+		SectionInfo &operator[](std::size_t i) { return sections[i]; }
+		std::size_t size() const { return sections.size(); }
+
+		// Returns the name of section si
+		const char *name(const SectionInfo &si) const { return strings.data() + si.name; }
+
+		// Returns the command of section si
+		const char *cmd(const SectionInfo &si) const { return strings.data() + si.cmd; }
+
+		// Returns the index of the section that runs after section # i
+		std::size_t next(std::size_t i) const { return i + 1 == sections.size() ? 0 : i + 1; }
+
+		// Returns the index of the first section of kind kind, or 0 if there isn't one
+		std::size_t find_kind(Section kind) const;
+
+		// Returns the offset of *str in strings, adding it if it isn't stored yet
+		std::uint32_t intern(std::string_view str);
+
+		// Builds starts from the durations of the sections
+		// Must be called again after the durations are changed
+		void index_starts();
+
+		// Finds the section that is running secs after the start of the first section, wrapping around at the end of the cycle
+		// Sets index to the index of the section and secs_left to the secs left in it
+		void seek(std::int64_t secs, std::size_t &index, int &secs_left) const;
 	};
 }
@@ -0,0 +1,234 @@
+/*
+ * reload.cc contains functions for reloading pomocom.conf and the pomo file while pomocom is running.
+ */
+
+#include <algorithm>	// For std::copy()
+#include <chrono>
+#include <cstring>	// For std::strcmp()
+#include <string>
+#include <string_view>
+#include <utility>	// For std::move() and std::pair
+#include <vector>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "error.hh"
+#include "jitter.hh"
+#include "pomo.hh"
+#include "reload.hh"
+#include "settings.hh"
+#include "state.hh"
+
+namespace pomocom
+{
+	// Events that mean a file in a watched directory was saved
+	// Saving in place closes the file after writing, and saving atomically renames a new file over it
+	constexpr std::uint32_t RELOAD_MASK = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+	// Name of the settings file in the path.config directory
+	constexpr std::string_view RELOAD_CONF_NAME = "pomocom.conf";
+
+	// inotify file descriptor, or -1 if files aren't watched
+	static int reload_fd = -1;
+
+	// Watch descriptors of the directories holding pomocom.conf and the pomo file, which are equal if it is the same directory
+	static int reload_wd_config = -1;
+	static int reload_wd_pomo = -1;
+
+	// Name of the pomo file in its directory
+	static std::string reload_pomo_name;
+
+	// Settings set on the command line, in the order they were set
+	static std::vector<std::pair<const char *, const char *>> reload_overrides;
+
+	// Length of each kind of section given with -q, used if reload_kind_secs_set is true
+	static int reload_kind_secs[SECTION_MAX];
+	static bool reload_kind_secs_set = false;
+
+	// Strings of settings that were replaced or failed to load, whose memory is reused by the next reload
+	static SettingStringArena reload_spare_strings;
+
+	// Reads pomocom.conf again and replaces state.settings if it has no errors
+	// Sets pomo_changed to true if a setting that the pomo file depends on changed
+	// Returns true if state.settings was replaced
+	static bool reload_settings(bool &pomo_changed);
+
+	// Reads the pomo file again and replaces state.sections if it has no errors
+	// Returns true if state.sections was replaced
+	static bool reload_sections(int &secs_delta);
+
+	// Records that setting *name was set to *value on the command line, so it can be applied again after pomocom.conf is reloaded
+	// *name and *value must outlive the program, like the strings in argv
+	void reload_add_override(const char *name, const char *value)
+	{
+		reload_overrides.emplace_back(name, value);
+	}
+
+	// Records the length of each kind of section given with -q, so they are set again after the pomo file is reloaded
+	// secs holds SECTION_MAX lengths, or is nullptr to keep the lengths in the pomo file
+	void reload_set_kind_secs(const int *secs)
+	{
+		reload_kind_secs_set = secs != nullptr;
+		if (secs != nullptr)
+			std::copy(secs, secs + SECTION_MAX, reload_kind_secs);
+	}
+
+	// Starts watching pomocom.conf and the pomo file named by state.file_name
+	// Returns the inotify file descriptor to wait on, or -1 if files can't be watched
+	int reload_open()
+	{
+		reload_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (reload_fd == -1)
+			return -1;
+
+		// path.config ends with '/'
+		reload_wd_config = inotify_add_watch(reload_fd, state.settings.path.config, RELOAD_MASK);
+		reload_watch_pomo();
+		return reload_fd;
+	}
+
+	// Watches the pomo file named by state.file_name instead of the one watched before
+	void reload_watch_pomo()
+	{
+		if (reload_fd == -1)
+			return;
+		if (reload_wd_pomo != -1 && reload_wd_pomo != reload_wd_config)
+			inotify_rm_watch(reload_fd, reload_wd_pomo);
+
+		// Adding a watch on the directory of pomocom.conf returns the watch descriptor it already has
+		std::string path = pomo_path(state.file_name);
+		std::size_t slash = path.rfind('/');
+		std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+		reload_pomo_name = slash == std::string::npos ? path : path.substr(slash + 1);
+		reload_wd_pomo = inotify_add_watch(reload_fd, dir.c_str(), RELOAD_MASK);
+	}
+
+	// Stops watching files
+	void reload_close()
+	{
+		if (reload_fd != -1)
+			close(reload_fd);
+		reload_fd = -1;
+		reload_wd_config = reload_wd_pomo = -1;
+	}
+
+	// Reads the events on the inotify file descriptor and reloads the files that changed
+	// state.current_section and state.current_section_secs are adjusted to match the new sections
+	ReloadResult reload_handle()
+	{
+		auto time_start = std::chrono::steady_clock::now();
+
+		// Find out which files changed, an editor may save a file several times in a row
+		bool conf_changed = false;
+		bool pomo_changed = false;
+		alignas(struct inotify_event) char buf[4096];
+		for (ssize_t len; (len = read(reload_fd, buf, sizeof(buf))) > 0;)
+		{
+			for (ssize_t i = 0; i < len;)
+			{
+				const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(buf + i);
+				i += sizeof(struct inotify_event) + ev->len;
+
+				// Events were dropped, so anything could have changed
+				if (ev->mask & IN_Q_OVERFLOW)
+				{
+					conf_changed = pomo_changed = true;
+					continue;
+				}
+				if (ev->len == 0)
+					continue;
+				if (ev->wd == reload_wd_config && ev->name == RELOAD_CONF_NAME)
+					conf_changed = true;
+				if (ev->wd == reload_wd_pomo && ev->name == reload_pomo_name)
+					pomo_changed = true;
+			}
+		}
+
+		ReloadResult result = {};
+		if (conf_changed)
+			result.settings = reload_settings(pomo_changed);
+		if (pomo_changed)
+			result.sections = reload_sections(result.secs_delta);
+
+		if (conf_changed || pomo_changed)
+			jitter_record(JITTER_RELOAD, time_start, std::chrono::steady_clock::now());
+		return result;
+	}
+
+	// Reads pomocom.conf again and replaces state.settings if it has no errors
+	// Sets pomo_changed to true if a setting that the pomo file depends on changed
+	// Returns true if state.settings was replaced
+	static bool reload_settings(bool &pomo_changed)
+	{
+		// Start from the defaults like on startup, so settings removed from pomocom.conf go back to their defaults
+		ProgramSettings s(std::move(reload_spare_strings));
+		bool ok;
+		try
+		{
+			ok = settings_read(s);
+			for (auto [name, value] : reload_overrides)
+				ok = setting_set(s, name, value) && ok;
+		}
+		catch (Exception &e)
+		{
+			ok = false;
+		}
+		if (!ok)
+		{
+			PERR("failed to reload pomocom.conf, keeping the settings from before");
+			reload_spare_strings = std::move(s.strings);
+			return false;
+		}
+
+		// The interface that is running can't be switched
+		s.interface = state.settings.interface;
+
+		// Commands starting with '+' depend on path.bin, pomo files are found in path.section, and classic pomo files depend on breaks_until_long_reset
+		bool section_dir_changed = std::strcmp(s.path.section, state.settings.path.section) != 0;
+		if (s.breaks_until_long_reset != state.settings.breaks_until_long_reset ||
+		    std::strcmp(s.path.bin, state.settings.path.bin) != 0 ||
+		    section_dir_changed)
+			pomo_changed = true;
+
+		// Nothing points into the strings of the old settings after they are replaced, so keep them for the next reload
+		std::swap(state.settings, s);
+		reload_spare_strings = std::move(s.strings);
+
+		// The pomo file is now found in another directory, so watch that one
+		if (section_dir_changed)
+			reload_watch_pomo();
+		return true;
+	}
+
+	// Reads the pomo file again and replaces state.sections if it has no errors
+	// Returns true if state.sections was replaced
+	static bool reload_sections(int &secs_delta)
+	{
+		SectionTable table;
+		try{ pomo_read(state.file_name, table); }
+		catch (Exception &e)
+		{
+			PERR("failed to reload pomo file \"%s\", keeping the sections from before", state.file_name);
+			return false;
+		}
+		if (reload_kind_secs_set)
+			pomo_set_kind_secs(table, reload_kind_secs);
+		for (const SectionInfo &si : table.sections)
+		{
+			if (si.secs <= 0)
+			{
+				PERR("invalid section length in pomo file \"%s\", keeping the sections from before", state.file_name);
+				return false;
+			}
+		}
+
+		// Stay on the same section if it still exists, and move its deadline by as much as its length changed
+		std::size_t index = state.current_section < table.size() ? state.current_section : 0;
+		secs_delta = table[index].secs - state.sections[state.current_section].secs;
+		state.current_section_secs = state.current_section_secs + secs_delta > 0 ? state.current_section_secs + secs_delta : 0;
+		state.current_section = index;
+		state.sections = std::move(table);
+		return true;
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * reload.hh contains functions for reloading pomocom.conf and the pomo file while pomocom is running.
+ *
+ * The directories holding pomocom.conf and the pomo file are watched with inotify, so editors that save by writing the file in place and editors that save by renaming a new file over it are both seen. The inotify file descriptor is watched by the terminal interfaces' Reactor, so nothing runs until a file actually changes.
+ *
+ * When a file changes, only that file is read again, into a new ProgramSettings or SectionTable, and the new values replace the old ones only once they were read without errors. The pomo file is also read again when a setting it depends on changed. A bad edit prints an error and leaves the timer as it was. Settings given on the command line are applied again after pomocom.conf is read, section lengths given with -q are applied again after the pomo file is read, and the interface can't be changed while pomocom is running.
+ *
+ * The current section keeps its deadline unless its own length was edited, in which case the deadline moves by the same amount. The time each reload takes is recorded with jitter_record() (see jitter.hh) and printed with --stats.
+ */
+
+#pragma once
+
+namespace pomocom
+{
+	// Changes made by reload_handle()
+	struct ReloadResult{
+		// True if state.settings was replaced
+		bool settings;
+
+		// True if state.sections was replaced
+		bool sections;
+
+		// Secs added to the length of the current section
+		int secs_delta;
+	};
+
+	// Records that setting *name was set to *value on the command line, so it can be applied again after pomocom.conf is reloaded
+	// *name and *value must outlive the program, like the strings in argv
+	void reload_add_override(const char *name, const char *value);
+
+	// Records the length of each kind of section given with -q, so they are set again after the pomo file is reloaded
+	// secs holds SECTION_MAX lengths, or is nullptr to keep the lengths in the pomo file
+	void reload_set_kind_secs(const int *secs);
+
+	// Starts watching pomocom.conf and the pomo file named by state.file_name
+	// Returns the inotify file descriptor to wait on, or -1 if files can't be watched
+	int reload_open();
+
+	// Watches the pomo file named by state.file_name instead of the one watched before
+	void reload_watch_pomo();
+
+	// Stops watching files
+	void reload_close();
+
+	// Reads the events on the inotify file descriptor and reloads the files that changed
+	// state.current_section and state.current_section_secs are adjusted to match the new sections
+	ReloadResult reload_handle();
+}
@@ -4,22 +4,29 @@
  * See settings.hh for an overview of the code for the settings system.
  */
 
+#include <array>	// For std::to_array()
+#include <bit>		// For std::bit_ceil()
+#include <cctype>	// For isdigit()
+#include <charconv>	// For std::from_chars()
 #include <cstddef>	// For std::ptrdiff_t and std::byte
-#include <cstdlib>	// For std::atoll(), std::getenv(), and offsetof
-#include <cstring>	// For strdup()
-#include <stdexcept>	// For std::out_of_range
+#include <cstdint>
+#include <cstdlib>	// For std::getenv() and offsetof
+#include <cstring>	// For std::memcpy()
+#include <new>		// For std::bad_alloc
+#include <span>
 #include <string>
+#include <string_view>
 #include <type_traits>	// For std::is_same_v
-#include <unordered_map>
+#include <utility>	// For std::exchange() and std::move()
 
-#include <ncurses.h>	// For COLOR_*
 
+#include "cache.hh"
 #include "error.hh"
-#include "fileio.hh"	// For pomocom::SmartFilePtr
+#include "fileio.hh"	// For pomocom::file_read_all()
 #include "settings.hh"
 
 // Defines setting_name as a setting by creating an entry in settings_map
-// Used in the initializer for settings_map
+// Used in the initializer for settings_table
 #define ADD_SETTING(setting_name)	{\
 						#setting_name,\
 						{\
@@ -30,10 +37,6 @@
 
 namespace pomocom
 {
-	// Maximum length of a token in the setting file
-	// A token in this case is any string without whitespace
-	constexpr int MAX_SETTING_TOKEN_LEN = 100;
-
 	// Returns the enum counterpart to setting type T
 	template <typename T>
 	consteval SettingType get_setting_type_from_variable_type()
@@ -49,8 +52,76 @@ namespace pomocom
 		throw EXCEPT_GENERIC;
 	}
 
-	// Map of settings that can be set by the user
-	const std::unordered_map<std::string_view, SettingDef> settings_map = {
+	// Perfect hash index of a table of N entries
+	// Every name in the table hashes to a different slot, so a lookup is one hash and one string comparison
+	template <std::size_t N>
+	struct NameIndex{
+		// Twice as many slots as entries makes a seed without collisions quick to find
+		static constexpr std::size_t SLOTS = std::bit_ceil(N * 2);
+
+		std::uint32_t seed;
+
+		// Index of the entry in each slot, or -1 if the slot is empty
+		std::array<std::int16_t, SLOTS> slots;
+	};
+
+	// Returns a hash of *name mixed with seed
+	// Only the length and a few chars are hashed, which is enough to tell the names in the tables apart
+	// make_name_index() checks this at compile time
+	static constexpr std::uint32_t name_hash(std::string_view name, std::uint32_t seed)
+	{
+		std::size_t len = name.size();
+		std::uint32_t h = seed * 0x9e3779b9u ^ len;
+		if (len > 0)
+		{
+			h = (h ^ (unsigned char) name[0]) * 16777619u;
+			h = (h ^ (unsigned char) name[len / 2]) * 16777619u;
+			h = (h ^ (unsigned char) name[len - 1]) * 16777619u;
+			if (len > 1)
+				h = (h ^ (unsigned char) name[len - 2]) * 16777619u;
+		}
+		return h ^ (h >> 15);
+	}
+
+	// Builds a perfect hash index of the names in entries by trying seeds until no names collide
+	template <typename T, std::size_t N>
+	consteval NameIndex<N> make_name_index(const std::array<T, N> &entries)
+	{
+		// Duplicate names would collide with every seed
+		for (std::size_t i = 0; i < N; ++i)
+			for (std::size_t j = i + 1; j < N; ++j)
+				if (entries[i].name == entries[j].name)
+					throw EXCEPT_GENERIC;
+
+		NameIndex<N> index{};
+		for (index.seed = 0;; ++index.seed)
+		{
+			index.slots.fill(-1);
+			bool collided = false;
+			for (std::size_t i = 0; i < N && !collided; ++i)
+			{
+				auto &slot = index.slots[name_hash(entries[i].name, index.seed) & (index.SLOTS - 1)];
+				if (slot != -1)
+					collided = true;
+				slot = i;
+			}
+			if (!collided)
+				return index;
+		}
+	}
+
+	// Returns the entry of entries named *name, or nullptr if there isn't one
+	template <typename T, std::size_t N>
+	static inline const T *find_by_name(const std::array<T, N> &entries, const NameIndex<N> &index, std::string_view name)
+	{
+		int i = index.slots[name_hash(name, index.seed) & (index.SLOTS - 1)];
+		if (i == -1 || entries[i].name != name)
+			return nullptr;
+		return &entries[i];
+	}
+
+	// Settings that can be set by the user
+	static constexpr auto settings_table = std::to_array<SettingEntry>({
 		ADD_SETTING(interface)
 		ADD_SETTING(update_interval)
 		ADD_SETTING(pause_before_section_start)
@@ -75,11 +146,14 @@ namespace pomocom
 		ADD_SETTING(set_terminal_title_countdown)
 		ADD_SETTING(wx.show_menu_bar)
 		ADD_SETTING(wx.show_resize_symbol)
-	};
+		ADD_SETTING(daemon.run_section_commands)
+		ADD_SETTING(journal.fsync)
+		ADD_SETTING(journal.compact_after)
+	});
 
-	// Map of keywords that translate into SettingInt values
+	// Keywords that translate into SettingInt values
 	// IMPORTANT: the keys should not start with a number because that will be seen as an indication that a setting value is a number
-	const std::unordered_map<std::string_view, SettingInt> settings_keyword_map = {
+	static constexpr auto settings_keyword_table = std::to_array<SettingKeyword>({
 		// Booleans
 		{"true", 1},
 		{"false", 0},
@@ -88,24 +162,106 @@ namespace pomocom
 		{"ncurses", INTERFACE_NCURSES},
 		{"ansi", INTERFACE_ANSI},
 		{"wx", INTERFACE_WX},
+		{"daemon", INTERFACE_DAEMON},
+
+		// Journal fsync policies
+		{"never", JOURNAL_FSYNC_NEVER},
+		{"always", JOURNAL_FSYNC_ALWAYS},
 
 		// Ncurses colors
-		{"default", -1},
-		{"black", COLOR_BLACK},
-		{"red", COLOR_RED},
-		{"green", COLOR_GREEN},
-		{"yellow", COLOR_YELLOW},
-		{"blue", COLOR_BLUE},
-		{"magenta", COLOR_MAGENTA},
-		{"cyan", COLOR_CYAN},
-		{"white", COLOR_WHITE},
+		{"default", SETTING_COLOR_DEFAULT},
+		{"black", SETTING_COLOR_BLACK},
+		{"red", SETTING_COLOR_RED},
+		{"green", SETTING_COLOR_GREEN},
+		{"yellow", SETTING_COLOR_YELLOW},
+		{"blue", SETTING_COLOR_BLUE},
+		{"magenta", SETTING_COLOR_MAGENTA},
+		{"cyan", SETTING_COLOR_CYAN},
+		{"white", SETTING_COLOR_WHITE},
+	});
+
+	// Perfect hash indexes of the tables, built at compile time
+	// Compilation fails if a table has duplicate names
+	static constexpr auto settings_index = make_name_index(settings_table);
+	static constexpr auto settings_keyword_index = make_name_index(settings_keyword_table);
+
+	constinit const std::span<const SettingEntry> settings_map(settings_table);
+	constinit const std::span<const SettingKeyword> settings_keyword_map(settings_keyword_table);
+
+	// Returns the definition of the setting named *name, or nullptr if there isn't one
+	const SettingDef *setting_find(std::string_view name)
+	{
+		const SettingEntry *entry = find_by_name(settings_table, settings_index, name);
+		return entry == nullptr ? nullptr : &entry->def;
+	}
+
+	// Returns the keyword named *name, or nullptr if there isn't one
+	const SettingKeyword *setting_keyword_find(std::string_view name)
+	{
+		return find_by_name(settings_keyword_table, settings_keyword_index, name);
+	}
+
+	// Classes of chars in pomocom.conf used by settings_parse()
+	enum ConfCharClass : std::uint8_t{
+		// Whitespace that separates tokens
+		CC_SPACE = 1,
+
+		// Chars that end a setting name
+		CC_NAME_END = 2,
 	};
 
-	// Calls strdup() and throws an exception on error
-	static inline const char *try_strdup(const char *str);
+	// Class bits of every char, so the parser checks a char with one table lookup
+	static constexpr auto conf_char_class = []()
+		{
+			std::array<std::uint8_t, 256> table{};
+			table[' '] = table['\t'] = table['\r'] = CC_SPACE | CC_NAME_END;
+			table['='] = table['#'] = CC_NAME_END;
+			return table;
+		}();
+
+	// # of bytes in each block of a SettingStringArena, enough for every default path
+	constexpr std::size_t SETTING_STRING_BLOCK_SIZE = 1024;
+
+	// Name of the cache file for pomocom.conf
+	constexpr std::string_view SETTINGS_CACHE_NAME = "settings.cache";
+
+	// Hash of the names, types, and offsets of every setting
+	// Cached settings are ignored when this changes
+	static constexpr std::uint64_t settings_layout_hash = []()
+		{
+			std::uint64_t h = cache_hash_number(sizeof(ProgramSettings));
+			for (const SettingEntry &e : settings_table)
+			{
+				h = cache_hash(e.name, h);
+				h = cache_hash_number(e.def.type, h);
+				h = cache_hash_number(e.def.offset, h);
+			}
+			return h;
+		}();
+
+	// Returns the # of bytes used to store a setting of type type, or 0 for ST_STRING
+	static constexpr std::size_t setting_type_size(SettingType type);
+
+	// Returns the cache key for settings read on top of the defaults in s
+	static std::uint64_t settings_cache_key(const ProgramSettings &s);
+
+	// Replaces data with the value of every setting in s
+	// Numbers are stored as their bytes, and strings are stored as a 4 byte length followed by their chars
+	static void settings_encode(const ProgramSettings &s, std::string &data);
+
+	// Sets every setting in s from data written by settings_encode()
+	// Returns false without changing s if data is malformed
+	static bool settings_decode(ProgramSettings &s, std::string_view data);
 
 	// Sets default settings values
 	ProgramSettings::ProgramSettings() :
+		ProgramSettings(SettingStringArena())
+	{
+	}
+
+	// Sets default settings values, storing strings in *strings after clearing it
+	// Used to reuse the memory of settings that were replaced
+	ProgramSettings::ProgramSettings(SettingStringArena &&strings) :
 		interface(INTERFACE_NCURSES),
 		update_interval(1),
 		pause_before_section_start(false),
@@ -121,31 +277,129 @@ namespace pomocom
 		ncurses({
 			.color = {
 				.pomocom = {
-					COLOR_BLUE,
-					-1,
+					SETTING_COLOR_BLUE,
+					SETTING_COLOR_DEFAULT,
 				},
 				.section_work = {
-					COLOR_YELLOW,
-					-1,
+					SETTING_COLOR_YELLOW,
+					SETTING_COLOR_DEFAULT,
 				},
 				.section_break = {
-					COLOR_GREEN,
-					-1,
+					SETTING_COLOR_GREEN,
+					SETTING_COLOR_DEFAULT,
 				},
 				.time = {
-					-1,
-					-1,
+					SETTING_COLOR_DEFAULT,
+					SETTING_COLOR_DEFAULT,
 				},
 			},
 		}),
 		wx({
 		        .show_menu_bar = true,
 			.show_resize_symbol = true,
-		})
-		{ settings_set_default_paths(path); }
+		}),
+		daemon({
+			.run_section_commands = true,
+		}),
+		journal({
+			.fsync = JOURNAL_FSYNC_NEVER,
+			.compact_after = 64,
+		}),
+		strings(std::move(strings))
+	{
+		this->strings.clear();
+		settings_set_default_paths(*this);
+	}
+
+	SettingStringArena::SettingStringArena() :
+		m_next(nullptr),
+		m_left(0),
+		m_first_size(0)
+	{
+	}
+
+	// Moving keeps the blocks where they are, so strings handed out before stay valid
+	// The arena moved from is left empty, and allocates a new block for the next string interned into it
+	SettingStringArena::SettingStringArena(SettingStringArena &&other) noexcept :
+		m_blocks(std::move(other.m_blocks)),
+		m_next(std::exchange(other.m_next, nullptr)),
+		m_left(std::exchange(other.m_left, 0)),
+		m_first_size(std::exchange(other.m_first_size, 0)),
+		m_strings(std::move(other.m_strings))
+	{
+		other.m_blocks.clear();
+		other.m_strings.clear();
+	}
+	SettingStringArena &SettingStringArena::operator=(SettingStringArena &&other) noexcept
+	{
+		if (this == &other)
+			return *this;
+		m_blocks = std::move(other.m_blocks);
+		m_next = std::exchange(other.m_next, nullptr);
+		m_left = std::exchange(other.m_left, 0);
+		m_first_size = std::exchange(other.m_first_size, 0);
+		m_strings = std::move(other.m_strings);
+		other.m_blocks.clear();
+		other.m_strings.clear();
+		return *this;
+	}
+
+	// Returns a null terminated copy of *str that lasts as long as the arena
+	// If an equal string was stored before, its copy is returned without allocating
+	// Throws EXCEPT_BAD_ALLOC if memory can't be allocated
+	SettingString SettingStringArena::intern(std::string_view str)
+	{
+		auto it = m_strings.find(str);
+		if (it != m_strings.end())
+			return it->data();
+
+		try
+		{
+			// Strings longer than a block get a block of their own
+			std::size_t size = str.size() + 1;
+			if (size > m_left)
+			{
+				std::size_t block_size = size > SETTING_STRING_BLOCK_SIZE ? size : SETTING_STRING_BLOCK_SIZE;
+				m_blocks.emplace_back(new char[block_size]);
+				m_next = m_blocks.back().get();
+				m_left = block_size;
+				if (m_blocks.size() == 1)
+					m_first_size = block_size;
+			}
+
+			char *copy = m_next;
+			std::memcpy(copy, str.data(), str.size());
+			copy[str.size()] = '\0';
+			m_next += size;
+			m_left -= size;
+
+			m_strings.emplace(copy, str.size());
+			return copy;
+		}
+		catch (std::bad_alloc &)
+		{
+			throw EXCEPT_BAD_ALLOC;
+		}
+	}
+
+	// Forgets every string and keeps the first block to copy new strings into
+	// Strings handed out before become invalid
+	void SettingStringArena::clear()
+	{
+		m_strings.clear();
+		if (m_blocks.empty())
+		{
+			m_next = nullptr;
+			m_left = 0;
+			return;
+		}
+		m_blocks.resize(1);
+		m_next = m_blocks[0].get();
+		m_left = m_first_size;
+	}
 
 	// Set default values for path settings
-	void settings_set_default_paths(ProgramSettings::Path &path)
+	void settings_set_default_paths(ProgramSettings &s)
 	{
 		// Path to home
 		char *path_home;
@@ -165,11 +419,11 @@ namespace pomocom
 		// Set paths
 		try
 		{
-			path.config = try_strdup(buf.c_str());
-			path.section = try_strdup(path.config);
-			path.bin = try_strdup(path.config);
+			s.path.config = s.strings.intern(buf);
+			s.path.section = s.path.config;
+			s.path.bin = s.path.config;
 			buf += "res/";
-			path.res = try_strdup(buf.c_str());
+			s.path.res = s.strings.intern(buf);
 		}
 		catch (...)
 		{
@@ -179,16 +433,26 @@ namespace pomocom
 	}
 
 	// Set the setting with name *setting_name to *setting_value
-	void setting_set(ProgramSettings &s, const char *setting_name, const char *setting_value)
+	// Returns false if no setting has that name or the value can't be converted
+	bool setting_set(ProgramSettings &s, std::string_view setting_name, std::string_view setting_value)
 	{
+		// Used to print the string views in error messages
+		int name_len = setting_name.size();
+		int value_len = setting_value.size();
+
 		// Get setting definition
-		const SettingDef *setting_def;
-		try{ setting_def = &settings_map.at(setting_name); }
-		catch (std::out_of_range &e)
+		const SettingDef *setting_def = setting_find(setting_name);
+		if (setting_def == nullptr)
 		{
 			// Setting with name *setting_name doesn't exist
-			PERR("no setting named \"%s\" exists", setting_name);
-			throw EXCEPT_IO;
+			PERR("no setting named \"%.*s\" exists", name_len, setting_name.data());
+			return false;
+		}
+
+		if (setting_value.empty() && setting_def->type != ST_STRING)
+		{
+			PERR("no value given for setting \"%.*s\"", name_len, setting_name.data());
+			return false;
 		}
 
 		// Pointer to setting variable
@@ -203,14 +467,11 @@ namespace pomocom
 			{
 				auto p = (SettingString *) setting_ptr;
 
-				// Free the old C string that the setting holds
-				std::free((void *) (*p));
-
-				// Duplicate *setting_value and make the setting point to the new string
-				try{ *p = try_strdup(setting_value); }
+				// Make the setting point to a copy of *setting_value in the arena
+				try{ *p = s.strings.intern(setting_value); }
 				catch (...)
 				{
-					PERR("failed to allocate mem when creating new string for setting \"%s\"", setting_name);
+					PERR("failed to allocate mem when creating new string for setting \"%.*s\"", name_len, setting_name.data());
 					throw EXCEPT_BAD_ALLOC;
 				}
 			}
@@ -220,23 +481,25 @@ namespace pomocom
 				// The setting is a number
 				
 				// Number that *setting_value will be converted into
-				SettingLong setting_value_number;
+				SettingLong setting_value_number = 0;
 				
 				if (isdigit(setting_value[0]))
 				{
 					// If the first character of *setting_value is a digit, assume that *setting_value is a number in string form
-					setting_value_number = std::atoll(setting_value);
+					// Like std::atoll(), chars after the number are ignored
+					std::from_chars(setting_value.data(), setting_value.data() + setting_value.size(), setting_value_number);
 				}
 				else
 				{
 					// Assume that *setting_value is a keyword
-					try{ setting_value_number = settings_keyword_map.at(setting_value); }
-					catch (std::out_of_range &e)
+					const SettingKeyword *keyword = setting_keyword_find(setting_value);
+					if (keyword == nullptr)
 					{
 						// No keyword exists, so the conversion failed
-						PERR("cannot convert setting value \"%s\" to a number", setting_value);
-						throw EXCEPT_IO;
+						PERR("cannot convert setting value \"%.*s\" to a number", value_len, setting_value.data());
+						return false;
 					}
+					setting_value_number = keyword->value;
 				}
 
 				// Set the setting
@@ -267,117 +530,264 @@ namespace pomocom
 						break;
 					}
 				default:
-					PERR("unknown number setting type for setting \"%s\"", setting_name);
-					throw EXCEPT_IO;
+					PERR("unknown number setting type for setting \"%.*s\"", name_len, setting_name.data());
+					return false;
 				}
 			}
 		}
+		return true;
 	}
 
 	// Read settings file
-	void settings_read(ProgramSettings &s)
+	// The parsed settings are cached (see cache.hh), and later calls load the cache instead if pomocom.conf hasn't changed
+	// Returns false if there were errors
+	bool settings_read(ProgramSettings &s)
 	{
 		// Get the path to the settings file (pomocom.conf)
 		std::string path_to_pomocom_conf(s.path.config);
 		path_to_pomocom_conf += "pomocom.conf";
 
-		// Open the file
-		SmartFilePtr sfp(path_to_pomocom_conf.c_str(), "r");
-		auto &fp = sfp.m_fp;
-
-		struct Token{
-			// String
-			char m_str[MAX_SETTING_TOKEN_LEN];
+		// Load the settings from the cache if pomocom.conf hasn't changed since it was cached
+		// The defaults that pomocom.conf doesn't override are part of the key
+		// Stamping it reads the whole file into one buffer, which is parsed in one pass if the cache is out of date
+		CacheStamp stamp;
+		std::string text;
+		bool stamped = cache_stamp(path_to_pomocom_conf.c_str(), stamp, text);
+		std::uint64_t key = settings_cache_key(s);
+		std::string data;
+		if (stamped && cache_load(SETTINGS_CACHE_NAME, stamp, key, data) && settings_decode(s, data))
+			return true;
+
+		// If the file couldn't be stamped, reading it again prints the error
+		if (!stamped)
+			file_read_all(path_to_pomocom_conf.c_str(), text);
+
+		// Files with errors aren't cached so that the errors are printed every time
+		if (!settings_parse(s, text, path_to_pomocom_conf.c_str()))
+			return false;
+		if (stamped)
+		{
+			settings_encode(s, data);
+			cache_store(SETTINGS_CACHE_NAME, stamp, key, data);
+		}
+		return true;
+	}
 
-			// Length
-			int m_len;
+	// Returns the # of bytes used to store a setting of type type, or 0 for ST_STRING
+	static constexpr std::size_t setting_type_size(SettingType type)
+	{
+		switch (type)
+		{
+		case ST_CHAR: return sizeof(SettingChar);
+		case ST_BOOL: return sizeof(SettingBool);
+		case ST_INT: return sizeof(SettingInt);
+		case ST_SHORT: return sizeof(SettingShort);
+		case ST_LONG: return sizeof(SettingLong);
+		default: return 0;
+		}
+	}
 
-			// Initialize length with 0
-			Token() : m_len(0) {}
+	// Returns the cache key for settings read on top of the defaults in s
+	static std::uint64_t settings_cache_key(const ProgramSettings &s)
+	{
+		std::uint64_t key = settings_layout_hash;
+		for (const SettingEntry &e : settings_map)
+		{
+			if (e.def.type == ST_STRING)
+				key = cache_hash(*(const SettingString *) (reinterpret_cast<const std::byte *>(&s) + e.def.offset), key);
+		}
+		return key;
+	}
 
-			// Adds c to the string
-			void add(const int &c)
+	// Replaces data with the value of every setting in s
+	// Numbers are stored as their bytes, and strings are stored as a 4 byte length followed by their chars
+	static void settings_encode(const ProgramSettings &s, std::string &data)
+	{
+		data.clear();
+		const std::byte *base = reinterpret_cast<const std::byte *>(&s);
+		for (const SettingEntry &e : settings_map)
+		{
+			const std::byte *setting_ptr = base + e.def.offset;
+			if (e.def.type == ST_STRING)
 			{
-				if (m_len >= MAX_SETTING_TOKEN_LEN - 1)
-				{
-					// m_str has max length, don't add to the string
-					return;
-				}
-				m_str[m_len] = c;
-				++m_len;
+				std::string_view str = *(const SettingString *) setting_ptr;
+				std::uint32_t len = str.size();
+				data.append((const char *) &len, sizeof(len));
+				data += str;
 			}
+			else
+				data.append((const char *) setting_ptr, setting_type_size(e.def.type));
+		}
+	}
 
-			// Resets length to 0
-			void reset(){ m_len = 0; }
+	// Sets every setting in s from data written by settings_encode()
+	// Returns false without changing s if data is malformed
+	static bool settings_decode(ProgramSettings &s, std::string_view data)
+	{
+		// Check that every value fits before changing anything
+		std::size_t pos = 0;
+		for (const SettingEntry &e : settings_map)
+		{
+			std::size_t size = setting_type_size(e.def.type);
+			if (e.def.type == ST_STRING)
+			{
+				std::uint32_t len;
+				if (data.size() - pos < sizeof(len))
+					return false;
+				std::memcpy(&len, data.data() + pos, sizeof(len));
+				size = sizeof(len) + len;
+			}
+			if (data.size() - pos < size)
+				return false;
+			pos += size;
+		}
+		if (pos != data.size())
+			return false;
 
-			void null_terminate(){ m_str[m_len] = '\0'; }
-		};
+		std::byte *base = reinterpret_cast<std::byte *>(&s);
+		pos = 0;
+		for (const SettingEntry &e : settings_map)
+		{
+			std::byte *setting_ptr = base + e.def.offset;
+			if (e.def.type == ST_STRING)
+			{
+				std::uint32_t len;
+				std::memcpy(&len, data.data() + pos, sizeof(len));
+				pos += sizeof(len);
 
-		// Tokens being read
-		Token setting_name;
-		Token setting_value;
+				*(SettingString *) setting_ptr = s.strings.intern(data.substr(pos, len));
+				pos += len;
+			}
+			else
+			{
+				std::size_t size = setting_type_size(e.def.type);
+				std::memcpy(setting_ptr, data.data() + pos, size);
+				pos += size;
+			}
+		}
+		return true;
+	}
 
-		// Line number being read in the settings file
-		int line_number = 1;
+	// Sets the settings in *text, which holds the contents of the settings file at *path
+	// Errors are printed with the line and column they were found at, and the rest of the file is still read
+	// Returns false if there were errors
+	bool settings_parse(ProgramSettings &s, std::string_view text, const char *path)
+	{
+		// Used to unescape quoted values without allocating for each line
+		std::string quoted;
 
-		// Character being read
-		int c;
+		bool ok = true;
 
-		// Start reading file data
-		for (;;)
+		int line_number = 0;
+		for (std::size_t line_start = 0; line_start < text.size();)
 		{
-		l_read_setting_name:
-			// Read setting name
-			switch (c = std::fgetc(fp))
+			// Find the end of the line
+			++line_number;
+			std::size_t line_end = text.find('\n', line_start);
+			if (line_end == std::string_view::npos)
+				line_end = text.size();
+			std::string_view line = text.substr(line_start, line_end - line_start);
+			line_start = line_end + 1;
+
+			// Returns the column of the char at line[i], counting from 1
+			auto column = [](std::size_t i){ return (int) i + 1; };
+
+			// Returns the index of the first char at or after line[i] that isn't in char class cc, or line.size() if there isn't one
+			auto skip = [&line](std::size_t i, std::uint8_t cc)
+				{
+					while (i < line.size() && (conf_char_class[(unsigned char) line[i]] & cc))
+						++i;
+					return i;
+				};
+
+			// Skip leading whitespace, blank lines, and comments
+			std::size_t i = skip(0, CC_SPACE);
+			if (i == line.size() || line[i] == '#')
+				continue;
+
+			// Read the setting name, which ends at whitespace or '='
+			std::size_t name_start = i;
+			while (i < line.size() && !(conf_char_class[(unsigned char) line[i]] & CC_NAME_END))
+				++i;
+			std::string_view name = line.substr(name_start, i - name_start);
+
+			// The name and value are separated by whitespace, '=', or both
+			i = skip(i, CC_SPACE);
+			if (i < line.size() && line[i] == '=')
+				i = skip(i + 1, CC_SPACE);
+
+			if (setting_find(name) == nullptr)
 			{
-			case ' ':
-				// Read setting value
-				for (;;)
+				PERR("%s:%d:%d: no setting named \"%.*s\" exists", path, line_number, column(name_start), (int) name.size(), name.data());
+				ok = false;
+				continue;
+			}
+
+			// Read the value
+			std::size_t value_start = i;
+			std::string_view value;
+			if (i < line.size() && line[i] == '"')
+			{
+				// Quoted values can hold any chars, with \" for a quote and \\ for a backslash
+				quoted.clear();
+				bool closed = false;
+				for (++i; i < line.size(); ++i)
 				{
-					switch (c = std::fgetc(fp))
+					char c = line[i];
+					if (c == '"')
 					{
-					case '\n':
-						// End of line found
-						setting_name.null_terminate();
-						setting_value.null_terminate();
-						try{ setting_set(s, setting_name.m_str, setting_value.m_str); }
-						catch (Exception &e){ PERR("error in pomocom.conf at line %d", line_number); }
-						setting_name.reset();
-						setting_value.reset();
-						++line_number; 
-						goto l_read_setting_name;
-					default:
-						// Collect char in setting_value
-						setting_value.add(c);
+						closed = true;
+						++i;
 						break;
 					}
+					if (c == '\\' && i + 1 < line.size())
+					{
+						c = line[++i];
+						if (c == 'n')
+							c = '\n';
+						else if (c == 't')
+							c = '\t';
+					}
+					quoted += c;
+				}
+				if (!closed)
+				{
+					PERR("%s:%d:%d: missing closing quote", path, line_number, column(value_start));
+					ok = false;
+					continue;
 				}
-			case EOF:
-				// End of file found, exit the function
-				return;
-			default:
-				// Collect char in setting_name
-				setting_name.add(c);
-				break;
-			}
-		}
-	}
 
-	// Free all string settings
-	void settings_free_strings(ProgramSettings &s)
-	{
-		std::free((void *) s.path.config);
-		std::free((void *) s.path.section);
-		std::free((void *) s.path.bin);
-		std::free((void *) s.path.res);
-	}
+				// Only whitespace and a comment can come after the closing quote
+				i = skip(i, CC_SPACE);
+				if (i < line.size() && line[i] != '#')
+				{
+					PERR("%s:%d:%d: unexpected text after quoted value", path, line_number, column(i));
+					ok = false;
+					continue;
+				}
+				value = quoted;
+			}
+			else
+			{
+				// Unquoted values end at a comment or the end of the line, and trailing whitespace is dropped
+				std::size_t value_end = value_start;
+				for (std::size_t j = value_start; j < line.size(); ++j)
+				{
+					char c = line[j];
+					if (c == '#' && (conf_char_class[(unsigned char) line[j - 1]] & CC_SPACE))
+						break;
+					if (!(conf_char_class[(unsigned char) c] & CC_SPACE))
+						value_end = j + 1;
+				}
+				value = line.substr(value_start, value_end - value_start);
+			}
 
-	// Calls strdup() and throws an exception on error
-	static inline const char *try_strdup(const char *str)
-	{
-		const char *duplicated_str = strdup(str);
-		if (duplicated_str == nullptr)
-			throw EXCEPT_BAD_ALLOC;
-		return duplicated_str;
+			if (!setting_set(s, name, value))
+			{
+				PERR("%s:%d:%d: invalid value for setting \"%.*s\"", path, line_number, column(value_start), (int) name.size(), name.data());
+				ok = false;
+			}
+		}
+		return ok;
 	}
 }
@@ -1,21 +1,26 @@
 /*
  * settings.hh contains types used for settings and functions for manipulating settings.
  *
- * All program settings are stored in a ProgramSettings object, which is contained in the global state object (see state.hh). Each member of the ProgramSettings object are of a special type designated for settings. In settings.cc, a macro is used to specify which of these members will be included the settings_map map, which keeps track of all settings that end users can modify.
+ * All program settings are stored in a ProgramSettings object, which is contained in the global state object (see state.hh). Each member of the ProgramSettings object are of a special type designated for settings. In settings.cc, a macro is used to specify which of these members will be included the settings_map table, which keeps track of all settings that end users can modify.
  *
- * The key for settings_map is a string that identifies the name of a setting. The value is a SettingDef object which stores the type of setting in an enum and a memory offset of the setting variable relative to the first byte of a ProgramSettings object. This data is needed to know how to modify the value of each setting, which is done in setting_set().
+ * Each entry of settings_map has a string that identifies the name of a setting and a SettingDef object which stores the type of setting in an enum and a memory offset of the setting variable relative to the first byte of a ProgramSettings object. This data is needed to know how to modify the value of each setting, which is done in setting_set().
  *
- * Each setting type is an integer of varying widths except for SettingString. SettingString variables are assigned their own unique C string in memory to point to. Each time the value of a string setting is changed using setting_set(), the old value of the setting is passed to std::free() and new memory is allocated for the new string value. When pomocom exits, all string settings are freed in settings_free_strings().
+ * settings_map and settings_keyword_map are constant arrays with perfect hash indexes that are built at compile time, so they cost nothing at startup and never allocate. Lookups that miss return nullptr instead of throwing.
  *
- * Keywords, or strings that can be converted into numbers, are stored in the settings_keyword_map map.
+ * Each setting type is an integer of varying widths except for SettingString. SettingString variables point to C strings stored in the SettingStringArena owned by the same ProgramSettings object. The arena copies strings into large blocks and gives equal strings the same copy, so changing a string setting with setting_set() doesn't free anything and only allocates when the new value hasn't been seen before. All of the strings are freed at once when the ProgramSettings object is destroyed, so adding a string setting doesn't need any cleanup code.
+ *
+ * Keywords, or strings that can be converted into numbers, are stored in the settings_keyword_map table.
  */
 
 #pragma once
 
 #include <cstdint>
 #include <cstddef>	// For std::ptrdiff_t
-#include <string>
-#include <unordered_map>
+#include <memory>	// For std::unique_ptr
+#include <span>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
 
 #include "pomocom.hh"
 
@@ -33,6 +38,34 @@ namespace pomocom
 
 		// Interface using wxWidgets
 		INTERFACE_WX,
+
+		// Headless interface that runs many sessions controlled through stdin
+		INTERFACE_DAEMON,
+	};
+
+	// When the journal (see journal.hh) is flushed to disk
+	enum JournalFsync{
+		// Never call fdatasync(), so entries survive pomocom crashing but not the system crashing
+		JOURNAL_FSYNC_NEVER,
+
+		// Call fdatasync() after every entry
+		JOURNAL_FSYNC_ALWAYS,
+	};
+
+	// Colors for the ncurses interface, numbered like the COLOR_* constants of curses so they can be passed to init_pair()
+	// They are defined here so that reading settings doesn't need the ncurses headers
+	enum SettingColor{
+		// The terminal's own foreground or background color
+		SETTING_COLOR_DEFAULT = -1,
+
+		SETTING_COLOR_BLACK,
+		SETTING_COLOR_RED,
+		SETTING_COLOR_GREEN,
+		SETTING_COLOR_YELLOW,
+		SETTING_COLOR_BLUE,
+		SETTING_COLOR_MAGENTA,
+		SETTING_COLOR_CYAN,
+		SETTING_COLOR_WHITE,
 	};
 
 	// Setting type IDs
@@ -59,6 +92,45 @@ namespace pomocom
 	static_assert(sizeof(SettingLong) > sizeof(SettingInt), SETTING_LONG_ASSERT_MSG);
 	static_assert(sizeof(SettingLong) > sizeof(SettingShort), SETTING_LONG_ASSERT_MSG);
 
+	// Storage for the values of string settings
+	// Strings are copied into blocks that are only freed when the arena is destroyed
+	struct SettingStringArena{
+	private:
+		// Blocks of memory that strings are copied into
+		std::vector<std::unique_ptr<char[]>> m_blocks;
+
+		// Next free byte of the last block
+		char *m_next;
+
+		// # of free bytes in the last block starting at m_next
+		std::size_t m_left;
+
+		// # of bytes in the first block, which clear() keeps
+		std::size_t m_first_size;
+
+		// Every string in the arena, used to find a copy of a string that is already stored
+		std::unordered_set<std::string_view> m_strings;
+	public:
+		SettingStringArena();
+
+		SettingStringArena(const SettingStringArena &) = delete;
+		SettingStringArena &operator=(const SettingStringArena &) = delete;
+
+		// Moving keeps the blocks where they are, so strings handed out before stay valid
+		// The arena moved from is left empty, and allocates a new block for the next string interned into it
+		SettingStringArena(SettingStringArena &&other) noexcept;
+		SettingStringArena &operator=(SettingStringArena &&other) noexcept;
+
+		// Returns a null terminated copy of *str that lasts as long as the arena
+		// If an equal string was stored before, its copy is returned without allocating
+		// Throws EXCEPT_BAD_ALLOC if memory can't be allocated
+		SettingString intern(std::string_view str);
+
+		// Forgets every string and keeps the first block to copy new strings into
+		// Strings handed out before become invalid
+		void clear();
+	};
+
 	// Program settings
 	struct ProgramSettings{
 		// Meant to hold a value of type ProgramInterface
@@ -87,8 +159,7 @@ namespace pomocom
 		} key;
 
 		// Paths
-		// These should all be C strings that end in with '/'
-		// IMPORTANT: each path should point to unique memory because std::free() will be called on all of them when pomocom exits
+		// These should all be C strings that end in with '/' stored in strings
 		struct Path{
 			// Path to directory where config files are stored
 			SettingString config;
@@ -132,8 +203,28 @@ namespace pomocom
 			SettingBool show_resize_symbol;
 		} wx;
 
+		struct Daemon{
+			// Runs the section commands of daemon sessions when they switch sections
+			SettingBool run_section_commands;
+		} daemon;
+
+		struct Journal{
+			// Meant to hold a value of type JournalFsync
+			SettingInt fsync;
+
+			// # of entries appended to the journal before it is compacted into a snapshot
+			SettingShort compact_after;
+		} journal;
+
+		// Holds the values of the string settings above
+		SettingStringArena strings;
+
 		// Sets default settings values
 		ProgramSettings();
+
+		// Sets default settings values, storing strings in *strings after clearing it
+		// Used to reuse the memory of settings that were replaced
+		explicit ProgramSettings(SettingStringArena &&strings);
 	};
 
 	// Definition for a setting of a specified type with a memory address at the address of a ProgramSettings object + offset
@@ -142,25 +233,44 @@ namespace pomocom
 		std::ptrdiff_t offset;
 	};
 
-	// Map of settings
-	// Key:   string containing name of setting
-	// Value: SettingDef object
-	extern const std::unordered_map<std::string_view, SettingDef> settings_map;
+	// Entry of settings_map
+	struct SettingEntry{
+		std::string_view name;
+		SettingDef def;
+	};
+
+	// Entry of settings_keyword_map
+	struct SettingKeyword{
+		std::string_view name;
+		SettingInt value;
+	};
+
+	// Table of settings
+	extern const std::span<const SettingEntry> settings_map;
 
-	// Map of keywords that translate into SettingInt values
-	// Key:   string containing name of keyword
-	// Value: SettingInt object
-	extern const std::unordered_map<std::string_view, SettingInt> settings_keyword_map;
+	// Table of keywords that translate into SettingInt values
+	extern const std::span<const SettingKeyword> settings_keyword_map;
+
+	// Returns the definition of the setting named *name, or nullptr if there isn't one
+	const SettingDef *setting_find(std::string_view name);
+
+	// Returns the keyword named *name, or nullptr if there isn't one
+	const SettingKeyword *setting_keyword_find(std::string_view name);
 
 	// Set default values for path settings
-	void settings_set_default_paths(ProgramSettings::Path &path);
+	void settings_set_default_paths(ProgramSettings &s);
 
 	// Set the setting with name *setting_name to *setting_value
-	void setting_set(ProgramSettings &s, const char *setting_name, const char *setting_value);
+	// Returns false if no setting has that name or the value can't be converted
+	bool setting_set(ProgramSettings &s, std::string_view setting_name, std::string_view setting_value);
 
 	// Read settings file
-	void settings_read(ProgramSettings &s);
-
-	// Free all string settings
-	void settings_free_strings(ProgramSettings &s);
+	// The parsed settings are cached (see cache.hh), and later calls load the cache instead if pomocom.conf hasn't changed
+	// Returns false if there were errors
+	bool settings_read(ProgramSettings &s);
+
+	// Sets the settings in *text, which holds the contents of the settings file at *path
+	// Errors are printed with the line and column they were found at, and the rest of the file is still read
+	// Returns false if there were errors
+	bool settings_parse(ProgramSettings &s, std::string_view text, const char *path);
 }
@@ -0,0 +1,62 @@
+/*
+ * startup.cc contains functions for timing the phases of pomocom's startup.
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include "startup.hh"
+
+namespace pomocom
+{
+	// Time that static data was initialized, which phases are timed from
+	static const std::chrono::steady_clock::time_point startup_origin = std::chrono::steady_clock::now();
+
+	// Names and end times of the marked phases
+	static const char *startup_phases[STARTUP_PHASES_MAX];
+	static std::chrono::steady_clock::time_point startup_times[STARTUP_PHASES_MAX];
+
+	// # of phases marked
+	static int startup_len = 0;
+
+	// True if startup is being profiled
+	static bool startup_enabled = false;
+
+	// Marks the end of the startup phase named *phase
+	// *phase must be a string literal or otherwise outlive the program
+	void startup_mark(const char *phase)
+	{
+		if (startup_len == STARTUP_PHASES_MAX)
+			return;
+		startup_times[startup_len] = std::chrono::steady_clock::now();
+		startup_phases[startup_len] = phase;
+		++startup_len;
+	}
+
+	// Makes the interfaces quit after drawing their first frame so that startup can be profiled
+	void startup_profile_enable()
+	{
+		startup_enabled = true;
+	}
+
+	// Returns true if startup is being profiled
+	bool startup_profiling()
+	{
+		return startup_enabled;
+	}
+
+	// Prints how long each phase took to file
+	void startup_print(std::FILE *file)
+	{
+		// One line per phase in a format that scripts/bench_startup.sh can parse
+		std::fprintf(file, "%-28s %10s %10s\n", "phase", "us", "total us");
+		auto prev = startup_origin;
+		for (int i = 0; i < startup_len; ++i)
+		{
+			std::fprintf(file, "%-28s %10.1f %10.1f\n", startup_phases[i],
+				std::chrono::duration<double, std::micro>(startup_times[i] - prev).count(),
+				std::chrono::duration<double, std::micro>(startup_times[i] - startup_origin).count());
+			prev = startup_times[i];
+		}
+	}
+}
@@ -0,0 +1,30 @@
+/*
+ * startup.hh contains functions for timing the phases of pomocom's startup.
+ *
+ * The end of each phase is marked with startup_mark(), which only stores a monotonic clock reading, so phases are always marked. "pomocom --profile-startup" starts normally, quits as soon as the interface has drawn its first frame, and then prints how long each phase took. Times are measured from when the program's static data was initialized, which happens after the dynamic linker has loaded the libraries and before main() runs.
+ *
+ * scripts/bench_startup.sh runs many profiled starts and prints percentiles of each phase.
+ */
+
+#pragma once
+
+#include <cstdio>	// For std::FILE
+
+namespace pomocom
+{
+	// Max # of phases that can be marked, later marks are dropped
+	constexpr int STARTUP_PHASES_MAX = 16;
+
+	// Marks the end of the startup phase named *phase
+	// *phase must be a string literal or otherwise outlive the program
+	void startup_mark(const char *phase);
+
+	// Makes the interfaces quit after drawing their first frame so that startup can be profiled
+	void startup_profile_enable();
+
+	// Returns true if startup is being profiled
+	bool startup_profiling();
+
+	// Prints how long each phase took to file
+	void startup_print(std::FILE *file);
+}
@@ -4,25 +4,41 @@
 
 #pragma once
 
-#include "pomocom.hh"	// For Section and SectionInfo
+#include "pomocom.hh"	// For SectionTable
 #include "settings.hh"	// For ProgramSettings
 
 namespace pomocom
 {
+	// Ways the first section can be started
+	enum FirstSection{
+		// Start the section the way the settings say to
+		FIRST_SECTION_DEFAULT,
+
+		// Wait for the section to be begun, even if pause_before_section_start is off
+		FIRST_SECTION_PAUSED,
+
+		// Start timing the section right away, even if pause_before_section_start is on
+		FIRST_SECTION_RUNNING,
+	};
+
 	// Global state
 	struct ProgramState{
 		ProgramSettings settings;
 
-		// Current section being timed
-		Section current_section;
+		// Index of the current section being timed in sections
+		std::size_t current_section;
+
+		// Secs left in the current section when it starts being timed
+		// This is the duration of the section unless pomocom was started partway through it
+		int current_section_secs;
 
-		// # of breaks left until long break
-		int breaks_until_long;
+		// How the first section is started, used to resume a section as it was left
+		FirstSection first_section;
 
 		// C string containing the name of the pomo file opened
 		const char *file_name;
 
-		SectionInfo section_info[SECTION_MAX];
+		SectionTable sections;
 	};
 
 	extern ProgramState state;
@@ -0,0 +1,106 @@
+/*
+ * status_page.cc contains the functions for writing the shared memory status page.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <new>		// For placement new
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.hh"
+#include "status_page.hh"
+
+namespace pomocom
+{
+	// Page mapped by status_page_open(), or nullptr if there isn't one
+	static StatusPage *status_page = nullptr;
+
+	// Path of the page mapped by status_page_open()
+	static std::string status_page_file;
+
+	// Creates the status page file and maps it for writing
+	// If it can't be created, an error is printed and status_page_write() does nothing
+	void status_page_open()
+	{
+		status_page_file = status_page_path();
+
+		// The /tmp fallback is shared with other users, so don't follow a link planted there, and don't truncate a file that isn't ours
+		int fd = open(status_page_file.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0644);
+		if (fd == -1)
+		{
+			PERR("failed to create status page \"%s\"", status_page_file.c_str());
+			return;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == -1 || st.st_uid != getuid() || !S_ISREG(st.st_mode))
+		{
+			PERR("status page \"%s\" isn't a file owned by this user, not writing it", status_page_file.c_str());
+			close(fd);
+			return;
+		}
+
+		void *addr = MAP_FAILED;
+		if (ftruncate(fd, sizeof(StatusPage)) == 0)
+			addr = mmap(nullptr, sizeof(StatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED)
+		{
+			PERR("failed to map status page \"%s\"", status_page_file.c_str());
+			unlink(status_page_file.c_str());
+			return;
+		}
+
+		// Start from an empty page with a paused section 0
+		std::memset(addr, 0, sizeof(StatusPage));
+		status_page = new (addr) StatusPage;
+		status_page->version = STATUS_PAGE_VERSION;
+		status_page->paused.store(1, std::memory_order_relaxed);
+
+		// Readers check the magic number last, so write it last
+		std::atomic_thread_fence(std::memory_order_release);
+		status_page->magic = STATUS_PAGE_MAGIC;
+	}
+
+	// Unmaps and removes the status page file
+	void status_page_close()
+	{
+		if (status_page == nullptr)
+			return;
+		munmap(status_page, sizeof(StatusPage));
+		unlink(status_page_file.c_str());
+		status_page = nullptr;
+	}
+
+	// Writes the current section to the status page
+	// deadline is only used if paused is false, and secs_left_paused is only used if paused is true
+	void status_page_write(int section, const char *name, bool paused, int secs_left_paused, std::chrono::steady_clock::time_point deadline)
+	{
+		if (status_page == nullptr)
+			return;
+		StatusPage &page = *status_page;
+
+		// Pack the name into words before starting the write so that seq is odd for as short as possible
+		std::uint64_t name_words[STATUS_PAGE_NAME_WORDS] = {};
+		std::strncpy(reinterpret_cast<char *>(name_words), name, sizeof(name_words) - 1);
+
+		// Make seq odd, and make sure that happens before any field changes
+		std::uint32_t seq = page.seq.load(std::memory_order_relaxed);
+		page.seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		page.section.store(section, std::memory_order_relaxed);
+		page.paused.store(paused, std::memory_order_relaxed);
+		page.secs_left_paused.store(secs_left_paused, std::memory_order_relaxed);
+		page.deadline_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(), std::memory_order_relaxed);
+		for (int i = 0; i < STATUS_PAGE_NAME_WORDS; ++i)
+			page.name[i].store(name_words[i], std::memory_order_relaxed);
+
+		// Make seq even again after every field has changed
+		page.seq.store(seq + 2, std::memory_order_release);
+	}
+}
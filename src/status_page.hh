@@ -0,0 +1,165 @@
+/*
+ * status_page.hh contains the shared memory status page and the functions for reading it.
+ *
+ * While a timer is running, pomocom keeps a small file at $XDG_RUNTIME_DIR/pomocom.status (or /tmp/pomocom-(uid).status if $XDG_RUNTIME_DIR isn't set) mapped into memory. The page holds the current section, its name, its deadline, and whether it is paused. Programs that show the timer, like status bars, can map the page once with status_page_map() and then call status_page_read() as often as they like without making syscalls or spawning processes.
+ *
+ * The page is protected by a seqlock. The writer makes seq odd before changing the page and even again afterward. Readers retry when seq is odd or changed while they were reading.
+ *
+ * This header doesn't depend on anything but the C++ standard library and POSIX, so it can be copied into other programs.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>	// For std::getenv()
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pomocom
+{
+	// First 4 bytes of a status page ("pomo" in little endian)
+	constexpr std::uint32_t STATUS_PAGE_MAGIC = 0x6f6d6f70;
+
+	// Changed when the layout of StatusPage changes
+	constexpr std::uint32_t STATUS_PAGE_VERSION = 1;
+
+	// # of 8 byte words used to store the section name, including its null terminator
+	constexpr int STATUS_PAGE_NAME_WORDS = 13;
+
+	// Layout of the status page file
+	// Every field after seq is atomic so that readers racing with the writer are well defined
+	struct StatusPage{
+		std::uint32_t magic;
+		std::uint32_t version;
+
+		// Odd while the page is being written
+		std::atomic<std::uint32_t> seq;
+
+		// Kind of section (see Section in pomocom.hh)
+		std::atomic<std::int32_t> section;
+
+		// 1 if the section is paused or hasn't started yet, 0 if it is being timed
+		std::atomic<std::int32_t> paused;
+
+		// Secs left in the section when it was paused
+		std::atomic<std::int32_t> secs_left_paused;
+
+		// End of the section in nanoseconds on CLOCK_MONOTONIC (std::chrono::steady_clock), only used when not paused
+		std::atomic<std::int64_t> deadline_ns;
+
+		// Null terminated section name
+		std::atomic<std::uint64_t> name[STATUS_PAGE_NAME_WORDS];
+	};
+
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free,
+		"status page atomics must be lock free to be shared between processes");
+
+	// A consistent copy of the status page
+	struct StatusSnapshot{
+		int section;
+		bool paused;
+
+		// Secs left in the section, rounded up
+		int secs_left;
+
+		char name[STATUS_PAGE_NAME_WORDS * 8];
+	};
+
+	// Returns the path of the status page file
+	inline std::string status_page_path()
+	{
+		const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+		if (runtime_dir != nullptr && runtime_dir[0] != '\0')
+			return std::string(runtime_dir) + "/pomocom.status";
+		return "/tmp/pomocom-" + std::to_string(getuid()) + ".status";
+	}
+
+	// Maps the status page of the running pomocom read only
+	// Returns nullptr if no pomocom has created a status page, or if the page belongs to another user
+	// The page stays valid after pomocom exits, but it stops being updated
+	inline const StatusPage *status_page_map()
+	{
+		int fd = open(status_page_path().c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd == -1)
+			return nullptr;
+		struct stat st;
+		if (fstat(fd, &st) == -1 || st.st_uid != getuid() || !S_ISREG(st.st_mode) || st.st_size < static_cast<off_t>(sizeof(StatusPage)))
+		{
+			close(fd);
+			return nullptr;
+		}
+
+		void *addr = mmap(nullptr, sizeof(StatusPage), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED)
+			return nullptr;
+
+		const StatusPage *page = static_cast<const StatusPage *>(addr);
+		if (page->magic != STATUS_PAGE_MAGIC || page->version != STATUS_PAGE_VERSION)
+		{
+			munmap(addr, sizeof(StatusPage));
+			return nullptr;
+		}
+		return page;
+	}
+
+	// Unmaps a page returned by status_page_map()
+	inline void status_page_unmap(const StatusPage *page)
+	{
+		munmap(const_cast<StatusPage *>(page), sizeof(StatusPage));
+	}
+
+	// Copies the status page into snap
+	// Doesn't make any syscalls, since clock_gettime() for CLOCK_MONOTONIC is handled by the vDSO
+	inline void status_page_read(const StatusPage &page, StatusSnapshot &snap)
+	{
+		std::int64_t deadline_ns;
+		std::uint64_t name[STATUS_PAGE_NAME_WORDS];
+		for (;;)
+		{
+			std::uint32_t seq = page.seq.load(std::memory_order_acquire);
+			if (seq & 1)
+				continue;
+
+			snap.section = page.section.load(std::memory_order_relaxed);
+			snap.paused = page.paused.load(std::memory_order_relaxed);
+			snap.secs_left = page.secs_left_paused.load(std::memory_order_relaxed);
+			deadline_ns = page.deadline_ns.load(std::memory_order_relaxed);
+			for (int i = 0; i < STATUS_PAGE_NAME_WORDS; ++i)
+				name[i] = page.name[i].load(std::memory_order_relaxed);
+
+			// Make sure the loads above happen before seq is checked again
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (page.seq.load(std::memory_order_relaxed) == seq)
+				break;
+		}
+
+		std::memcpy(snap.name, name, sizeof(snap.name));
+		snap.name[sizeof(snap.name) - 1] = '\0';
+
+		if (!snap.paused)
+		{
+			auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			std::int64_t left_ns = deadline_ns - now_ns;
+			snap.secs_left = left_ns > 0 ? (left_ns + 999999999) / 1000000000 : 0;
+		}
+	}
+
+	// Creates the status page file and maps it for writing
+	// If it can't be created, an error is printed and status_page_write() does nothing
+	void status_page_open();
+
+	// Unmaps and removes the status page file
+	void status_page_close();
+
+	// Writes the current section to the status page
+	// deadline is only used if paused is false, and secs_left_paused is only used if paused is true
+	void status_page_write(int section, const char *name, bool paused, int secs_left_paused, std::chrono::steady_clock::time_point deadline);
+}
@@ -0,0 +1,194 @@
+/*
+ * timing_wheel.cc contains a hierarchical timing wheel for scheduling many deadlines.
+ */
+
+#include <bit>		// For std::countr_zero()
+#include <cstdint>
+
+#include "timing_wheel.hh"
+
+namespace pomocom
+{
+	// Creates an empty wheel with the current tick set to now
+	TimingWheel::TimingWheel(std::uint64_t now) :
+		m_bitmap{},
+		m_now(now),
+		m_count(0)
+	{
+		for (WheelTimer &head : m_slots)
+			head.m_prev = head.m_next = &head;
+	}
+
+	// Schedules t to expire on tick expires
+	// If t is already scheduled, it is moved
+	// Timers with expiry ticks that have already passed expire on the next call to advance()
+	void TimingWheel::insert(WheelTimer &t, std::uint64_t expires)
+	{
+		if (t.scheduled())
+			unlink(t);
+		else
+			++m_count;
+
+		// The slot for the current tick has already been expired, so use the next one
+		t.m_expires = expires > m_now ? expires : m_now + 1;
+		place(t);
+	}
+
+	// Unschedules t if it is scheduled
+	void TimingWheel::cancel(WheelTimer &t)
+	{
+		if (!t.scheduled())
+			return;
+		unlink(t);
+		t.m_prev = t.m_next = nullptr;
+		--m_count;
+	}
+
+	// Returns a tick at or before the earliest expiry tick, or NEVER if no timers are scheduled
+	// Calling advance() with this tick either expires timers or cascades them closer to expiring
+	std::uint64_t TimingWheel::next_expiry() const
+	{
+		// Timers in lower levels always expire before timers in higher levels
+		// Timers at level L are always in a slot after the current slot of level L
+		for (int level = 0; level < LEVELS; ++level)
+		{
+			int shift = level * SLOT_BITS;
+			int index = (m_now >> shift) & (SLOTS - 1);
+			int slot = find_next_slot(level, index);
+			if (slot != SLOTS)
+			{
+				// The tick where the slot is expired (level 0) or cascaded (other levels)
+				std::uint64_t block = (m_now >> shift) & ~std::uint64_t(SLOTS - 1);
+				return (block | slot) << shift;
+			}
+		}
+
+		// Overflowed timers are looked at again when the top level wraps around
+		const WheelTimer &overflow = m_slots[SLOT_OVERFLOW];
+		if (overflow.m_next != &overflow)
+		{
+			int shift = LEVELS * SLOT_BITS;
+			return ((m_now >> shift) + 1) << shift;
+		}
+
+		return NEVER;
+	}
+
+	// Puts t in the slot list for its expiry tick, which must not be before m_now
+	void TimingWheel::place(WheelTimer &t)
+	{
+		// Bits that differ between the expiry tick and the current tick decide the level
+		std::uint64_t diff = t.m_expires ^ m_now;
+
+		std::uint32_t slot = SLOT_OVERFLOW;
+		for (int level = 0; level < LEVELS; ++level)
+		{
+			int shift = level * SLOT_BITS;
+			if ((diff >> shift) < SLOTS)
+			{
+				int index = (t.m_expires >> shift) & (SLOTS - 1);
+				slot = level * SLOTS + index;
+				m_bitmap[level][index / 64] |= std::uint64_t(1) << (index % 64);
+				break;
+			}
+		}
+
+		// Add t to the end of the slot list
+		WheelTimer &head = m_slots[slot];
+		t.m_slot = slot;
+		t.m_next = &head;
+		t.m_prev = head.m_prev;
+		head.m_prev->m_next = &t;
+		head.m_prev = &t;
+	}
+
+	// Removes t from its slot list
+	void TimingWheel::unlink(WheelTimer &t)
+	{
+		t.m_prev->m_next = t.m_next;
+		t.m_next->m_prev = t.m_prev;
+
+		// Clear the bitmap bit if the slot is now empty
+		WheelTimer &head = m_slots[t.m_slot];
+		if (head.m_next == &head && t.m_slot != SLOT_OVERFLOW)
+		{
+			int level = t.m_slot / SLOTS;
+			int index = t.m_slot % SLOTS;
+			m_bitmap[level][index / 64] &= ~(std::uint64_t(1) << (index % 64));
+		}
+	}
+
+	// Moves the timers of the slots that end at the current tick into lower levels
+	void TimingWheel::cascade()
+	{
+		// Higher levels go first because their timers can land in a lower level slot that also needs to be cascaded
+		for (int level = LEVELS; level >= 1; --level)
+		{
+			int shift = level * SLOT_BITS;
+			std::uint64_t mask = (std::uint64_t(1) << shift) - 1;
+			if ((m_now & mask) != 0)
+				continue;
+
+			std::uint32_t slot;
+			if (level == LEVELS)
+				slot = SLOT_OVERFLOW;
+			else
+			{
+				int index = (m_now >> shift) & (SLOTS - 1);
+				slot = level * SLOTS + index;
+				m_bitmap[level][index / 64] &= ~(std::uint64_t(1) << (index % 64));
+			}
+
+			WheelTimer &head = m_slots[slot];
+			if (head.m_next == &head)
+				continue;
+
+			// Detach the slot list, then place each timer again relative to the current tick
+			WheelTimer *t = head.m_next;
+			head.m_prev->m_next = nullptr;
+			head.m_prev = head.m_next = &head;
+			while (t != nullptr)
+			{
+				WheelTimer *t_next = t->m_next;
+				place(*t);
+				t = t_next;
+			}
+		}
+	}
+
+	// Returns the index of the first occupied slot of level after slot index, or SLOTS if there isn't one
+	int TimingWheel::find_next_slot(int level, int index) const
+	{
+		int i = index + 1;
+		if (i >= SLOTS)
+			return SLOTS;
+
+		// Mask off the bits up to and including index in the first word
+		int word = i / 64;
+		std::uint64_t bits = m_bitmap[level][word] & (~std::uint64_t(0) << (i % 64));
+		for (;;)
+		{
+			if (bits != 0)
+				return word * 64 + std::countr_zero(bits);
+			if (++word == BITMAP_WORDS)
+				return SLOTS;
+			bits = m_bitmap[level][word];
+		}
+	}
+
+	// Detaches the list of the level 0 slot for the current tick and returns its first timer
+	// The detached timers form a nullptr terminated list through m_next
+	WheelTimer *TimingWheel::take_current_slot()
+	{
+		int index = m_now & (SLOTS - 1);
+		WheelTimer &head = m_slots[index];
+		if (head.m_next == &head)
+			return nullptr;
+
+		WheelTimer *first = head.m_next;
+		head.m_prev->m_next = nullptr;
+		head.m_prev = head.m_next = &head;
+		m_bitmap[0][index / 64] &= ~(std::uint64_t(1) << (index % 64));
+		return first;
+	}
+}
@@ -0,0 +1,134 @@
+/*
+ * timing_wheel.hh contains a hierarchical timing wheel for scheduling many deadlines.
+ *
+ * Time is measured in integer ticks. The wheel has LEVELS levels of SLOTS slots each, where a slot at level L covers SLOTS^L ticks. A timer is put in the lowest level whose range contains its expiry tick, so inserting and cancelling a timer are O(1) list operations. When the current tick crosses into a new block of a level, the timers in the matching slot of the level above are cascaded down. Timers more than SLOTS^LEVELS ticks away wait in an overflow list.
+ *
+ * Timers are intrusive: a WheelTimer is embedded in (or inherited by) the object being timed, so the wheel never allocates. A bitmap of occupied slots per level makes finding the next expiry and skipping over empty slots cheap.
+ */
+
+#pragma once
+
+#include <cstddef>	// For std::size_t
+#include <cstdint>
+
+namespace pomocom
+{
+	// A timer that can be scheduled in a TimingWheel
+	struct WheelTimer{
+		// Neighbors in the slot list, m_next is nullptr when the timer isn't scheduled
+		WheelTimer *m_prev = nullptr;
+		WheelTimer *m_next = nullptr;
+
+		// Tick that the timer expires on
+		std::uint64_t m_expires = 0;
+
+		// Index of the slot list the timer is in
+		std::uint32_t m_slot = 0;
+
+		// Returns true if the timer is in a wheel
+		bool scheduled() const { return m_next != nullptr; }
+	};
+
+	struct TimingWheel{
+	public:
+		static constexpr int LEVELS = 4;
+		static constexpr int SLOT_BITS = 8;
+		static constexpr int SLOTS = 1 << SLOT_BITS;
+
+		// Returned by next_expiry() when no timers are scheduled
+		static constexpr std::uint64_t NEVER = UINT64_MAX;
+	private:
+		static constexpr int BITMAP_WORDS = SLOTS / 64;
+
+		// Index of the overflow list in m_slots
+		static constexpr std::uint32_t SLOT_OVERFLOW = LEVELS * SLOTS;
+
+		// Sentinels of the circular slot lists, followed by the overflow list
+		WheelTimer m_slots[LEVELS * SLOTS + 1];
+
+		// Bit i of level L is set if slot i of level L isn't empty
+		std::uint64_t m_bitmap[LEVELS][BITMAP_WORDS];
+
+		// Current tick
+		std::uint64_t m_now;
+
+		// # of scheduled timers
+		std::size_t m_count;
+
+		// Puts t in the slot list for its expiry tick, which must not be before m_now
+		void place(WheelTimer &t);
+
+		// Removes t from its slot list
+		void unlink(WheelTimer &t);
+
+		// Moves the timers of the slots that end at the current tick into lower levels
+		void cascade();
+
+		// Returns the index of the first occupied slot of level after slot index, or SLOTS if there isn't one
+		int find_next_slot(int level, int index) const;
+
+		// Detaches the list of the level 0 slot for the current tick and returns its first timer
+		// The detached timers form a nullptr terminated list through m_next
+		WheelTimer *take_current_slot();
+	public:
+		// Creates an empty wheel with the current tick set to now
+		TimingWheel(std::uint64_t now = 0);
+
+		TimingWheel(const TimingWheel &) = delete;
+		TimingWheel &operator=(const TimingWheel &) = delete;
+
+		// Schedules t to expire on tick expires
+		// If t is already scheduled, it is moved
+		// Timers with expiry ticks that have already passed expire on the next call to advance()
+		void insert(WheelTimer &t, std::uint64_t expires);
+
+		// Unschedules t if it is scheduled
+		void cancel(WheelTimer &t);
+
+		// Returns a tick at or before the earliest expiry tick, or NEVER if no timers are scheduled
+		// Calling advance() with this tick either expires timers or cascades them closer to expiring
+		std::uint64_t next_expiry() const;
+
+		// Moves the current tick forward to now and calls on_expire(WheelTimer &) for each timer that expires
+		// on_expire() may insert or cancel timers
+		template <typename F>
+		void advance(std::uint64_t now, F &&on_expire);
+
+		// Returns the current tick
+		std::uint64_t now() const { return m_now; }
+
+		// Returns the # of scheduled timers
+		std::size_t size() const { return m_count; }
+	};
+
+	// Moves the current tick forward to now and calls on_expire(WheelTimer &) for each timer that expires
+	// on_expire() may insert or cancel timers
+	template <typename F>
+	void TimingWheel::advance(std::uint64_t now, F &&on_expire)
+	{
+		while (m_now < now)
+		{
+			// Jump straight to the next tick where something happens
+			// Ticks before it have no timers to expire or cascade
+			std::uint64_t next = next_expiry();
+			if (next > now)
+			{
+				m_now = now;
+				break;
+			}
+			m_now = next;
+			cascade();
+
+			// Expire the whole slot at once
+			WheelTimer *t = take_current_slot();
+			while (t != nullptr)
+			{
+				WheelTimer *t_next = t->m_next;
+				t->m_prev = t->m_next = nullptr;
+				--m_count;
+				on_expire(*t);
+				t = t_next;
+			}
+		}
+	}
+}